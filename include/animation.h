@@ -0,0 +1,192 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "bvh.h"
+#include "shadows.h"
+#include "structures.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Keyframe da câmera
+struct CameraKey {
+  int frame;
+  Vec3 eye, lookAt, up;
+};
+
+// Keyframe de um objeto (deslocamento em relação à posição da cena)
+struct ObjectKey {
+  int frame;
+  Vec3 offset;
+};
+
+// Caminho de animação: câmera e transformações de objetos por quadro
+struct Animation {
+  int numFrames;
+  std::vector<CameraKey> cameraKeys;
+  std::map<int, std::vector<ObjectKey>> objectKeys; // Índice do objeto
+
+  Animation() : numFrames(0) {}
+};
+
+// Interpolação Catmull-Rom entre p1 e p2 (t em [0, 1])
+Vec3 catmullRom(const Vec3 &p0, const Vec3 &p1, const Vec3 &p2,
+                const Vec3 &p3, double t) {
+  double t2 = t * t;
+  double t3 = t2 * t;
+  return (p1 * 2.0 + (p2 - p0) * t +
+          (p0 * 2.0 - p1 * 5.0 + p2 * 4.0 - p3) * t2 +
+          (p1 * 3.0 - p0 - p2 * 3.0 + p3) * t3) *
+         0.5;
+}
+
+// Interpola um campo dos keyframes (ordenados por quadro) no quadro dado
+template <typename Key, typename Getter>
+Vec3 interpolateKeys(const std::vector<Key> &keys, double frame,
+                     Getter get) {
+  if (frame <= keys.front().frame)
+    return get(keys.front());
+  if (frame >= keys.back().frame)
+    return get(keys.back());
+
+  size_t i = 0;
+  while (i + 1 < keys.size() && keys[i + 1].frame <= frame)
+    i++;
+
+  // Extremos repetidos para as tangentes nas pontas do caminho
+  const Key &k0 = keys[i > 0 ? i - 1 : i];
+  const Key &k1 = keys[i];
+  const Key &k2 = keys[i + 1];
+  const Key &k3 = keys[i + 2 < keys.size() ? i + 2 : i + 1];
+
+  double t = (frame - k1.frame) / (double)(k2.frame - k1.frame);
+  return catmullRom(get(k0), get(k1), get(k2), get(k3), t);
+}
+
+// Desloca a geometria do objeto no lugar, sem recarregar a cena
+void translateObject(Object &obj, const Vec3 &delta) {
+  if (obj.type == SPHERE) {
+    obj.center = obj.center + delta;
+  } else if (obj.type == POLYHEDRON) {
+    // n·(p - delta) + d = 0
+    for (Plane &plane : obj.faces)
+      plane.d -= plane.normal().dot(delta);
+    obj.faceArrays.assign(obj.faces);
+  } else if (obj.type == QUADRIC) {
+    // Q(p - delta): termos quadráticos não mudam, lineares e constante sim
+    double tx = delta.x, ty = delta.y, tz = delta.z;
+    double G = obj.G, H = obj.H, I = obj.I;
+    obj.J += obj.A * tx * tx + obj.B * ty * ty + obj.C * tz * tz +
+             obj.D * tx * ty + obj.E * tx * tz + obj.F * ty * tz - G * tx -
+             H * ty - I * tz;
+    obj.G = G - 2.0 * obj.A * tx - obj.D * ty - obj.E * tz;
+    obj.H = H - 2.0 * obj.B * ty - obj.D * tx - obj.F * tz;
+    obj.I = I - 2.0 * obj.C * tz - obj.E * tx - obj.F * ty;
+    obj.clip.min = obj.clip.min + delta;
+    obj.clip.max = obj.clip.max + delta;
+  } else if (obj.type == CSG) {
+    for (Object &child : obj.csgChildren)
+      translateObject(child, delta);
+  } else if (obj.type == MESH) {
+    // A malha é compartilhada e fica intacta: só o deslocamento muda
+    obj.meshOffset = obj.meshOffset + delta;
+  }
+}
+
+// Desloca a instância: o protótipo é compartilhado, só a transformação muda
+void translateInstance(Instance &inst, const Vec3 &delta) {
+  inst.toWorld = Transform::translate(delta) * inst.toWorld;
+  inst.toLocal = inst.toWorld.inverse();
+}
+
+// Carrega o arquivo de animação
+bool loadAnimation(const std::string &filename, Animation &anim) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Erro: Não foi possível abrir o arquivo de animação "
+              << filename << std::endl;
+    return false;
+  }
+
+  file >> anim.numFrames;
+
+  // 1 - Keyframes da câmera
+  int numCameraKeys;
+  file >> numCameraKeys;
+  for (int i = 0; i < numCameraKeys; i++) {
+    CameraKey key;
+    file >> key.frame;
+    file >> key.eye.x >> key.eye.y >> key.eye.z;
+    file >> key.lookAt.x >> key.lookAt.y >> key.lookAt.z;
+    file >> key.up.x >> key.up.y >> key.up.z;
+    anim.cameraKeys.push_back(key);
+  }
+
+  // 2 - Keyframes de objetos
+  int numObjectKeys = 0;
+  file >> numObjectKeys;
+  for (int i = 0; i < numObjectKeys; i++) {
+    int objectIdx;
+    ObjectKey key;
+    file >> objectIdx >> key.frame;
+    file >> key.offset.x >> key.offset.y >> key.offset.z;
+    anim.objectKeys[objectIdx].push_back(key);
+  }
+
+  if (!file || anim.numFrames <= 0) {
+    std::cerr << "Erro: Arquivo de animação inválido " << filename
+              << std::endl;
+    return false;
+  }
+
+  auto byFrame = [](const auto &a, const auto &b) { return a.frame < b.frame; };
+  std::sort(anim.cameraKeys.begin(), anim.cameraKeys.end(), byFrame);
+  for (auto &entry : anim.objectKeys)
+    std::sort(entry.second.begin(), entry.second.end(), byFrame);
+
+  file.close();
+  return true;
+}
+
+// Posiciona câmera e objetos da cena no quadro dado.
+// offsets guarda o deslocamento atual de cada objeto animado, de forma que
+// apenas a diferença para o quadro anterior é aplicada à geometria.
+void applyAnimationFrame(const Animation &anim, int frame, Scene &scene,
+                         std::map<int, Vec3> &offsets) {
+  if (!anim.cameraKeys.empty()) {
+    scene.eye = interpolateKeys(anim.cameraKeys, frame,
+                                [](const CameraKey &k) { return k.eye; });
+    scene.lookAt = interpolateKeys(anim.cameraKeys, frame,
+                                   [](const CameraKey &k) { return k.lookAt; });
+    scene.up = interpolateKeys(anim.cameraKeys, frame,
+                               [](const CameraKey &k) { return k.up; });
+  }
+
+  for (const auto &entry : anim.objectKeys) {
+    int idx = entry.first;
+    if (idx < 0 || idx >= sceneItemCount(scene) || entry.second.empty())
+      continue;
+
+    Vec3 offset = interpolateKeys(entry.second, frame,
+                                  [](const ObjectKey &k) { return k.offset; });
+    int objects = (int)scene.objects.size();
+    if (idx < objects)
+      translateObject(scene.objects[idx], offset - offsets[idx]);
+    else
+      translateInstance(scene.instances[idx - objects], offset - offsets[idx]);
+    offsets[idx] = offset;
+  }
+
+  // Objetos se moveram: ajusta as caixas da BVH sem reconstruí-la
+  if (!anim.objectKeys.empty())
+    refitBVH(scene);
+
+  // Olho e objetos mudaram: refaz as listas de oclusores das luzes
+  if (!anim.cameraKeys.empty() || !anim.objectKeys.empty())
+    buildShadowCasters(scene);
+}
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include "structures.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Coordenada a partir da qual a geometria é considerada ilimitada
+const double BOUNDS_LIMIT = 1e6;
+
+// Recorta um polígono convexo pelo semi-espaço do plano (distância <= 0).
+// Pontos onde as arestas cruzam o plano são adicionados a onPlane.
+std::vector<Vec3> clipPolygon(const std::vector<Vec3> &poly,
+                              const Plane &plane, std::vector<Vec3> &onPlane) {
+  std::vector<Vec3> result;
+  for (size_t i = 0; i < poly.size(); i++) {
+    const Vec3 &a = poly[i];
+    const Vec3 &b = poly[(i + 1) % poly.size()];
+    double da = plane.distance(a);
+    double db = plane.distance(b);
+
+    if (da <= 0)
+      result.push_back(a);
+    if ((da < 0 && db > 0) || (da > 0 && db < 0)) {
+      Vec3 p = a + (b - a) * (da / (da - db));
+      result.push_back(p);
+      onPlane.push_back(p);
+    } else if (da == 0) {
+      onPlane.push_back(a);
+    }
+  }
+  return result;
+}
+
+// Ordena pontos coplanares em torno do centróide, formando um polígono
+std::vector<Vec3> orderOnPlane(std::vector<Vec3> points, const Vec3 &normal) {
+  Vec3 centroid(0, 0, 0);
+  for (const Vec3 &p : points)
+    centroid = centroid + p;
+  centroid = centroid / (double)points.size();
+
+  Vec3 axis = fabs(normal.x) < 0.9 ? Vec3(1, 0, 0) : Vec3(0, 1, 0);
+  Vec3 u = normal.cross(axis).normalize();
+  Vec3 v = normal.cross(u);
+
+  std::sort(points.begin(), points.end(), [&](const Vec3 &a, const Vec3 &b) {
+    Vec3 da = a - centroid, db = b - centroid;
+    return atan2(da.dot(v), da.dot(u)) < atan2(db.dot(v), db.dot(u));
+  });
+  return points;
+}
+
+// Faces do poliedro (interseção de semi-espaços) limitado ao cubo de lado
+// 2 * BOUNDS_LIMIT: recorta o cubo por cada plano. Vazio se o poliedro for.
+std::vector<std::vector<Vec3>> polyhedronPolygons(
+    const std::vector<Plane> &faces) {
+  const double L = BOUNDS_LIMIT;
+  Vec3 c[8];
+  for (int i = 0; i < 8; i++)
+    c[i] = Vec3(i & 1 ? L : -L, i & 2 ? L : -L, i & 4 ? L : -L);
+
+  std::vector<std::vector<Vec3>> polys = {
+      {c[0], c[1], c[3], c[2]}, {c[4], c[5], c[7], c[6]},
+      {c[0], c[1], c[5], c[4]}, {c[2], c[3], c[7], c[6]},
+      {c[0], c[2], c[6], c[4]}, {c[1], c[3], c[7], c[5]}};
+
+  for (const Plane &plane : faces) {
+    std::vector<std::vector<Vec3>> clipped;
+    std::vector<Vec3> onPlane;
+    for (const auto &poly : polys) {
+      std::vector<Vec3> result = clipPolygon(poly, plane, onPlane);
+      if (result.size() >= 3)
+        clipped.push_back(result);
+    }
+    if (onPlane.size() >= 3)
+      clipped.push_back(orderOnPlane(onPlane, plane.normal()));
+    polys.swap(clipped);
+    if (polys.empty())
+      break;
+  }
+  return polys;
+}
+
+// Caixa do poliedro: envolve os vértices das faces recortadas
+AABB polyhedronBounds(const std::vector<Plane> &faces) {
+  const double L = BOUNDS_LIMIT;
+  std::vector<std::vector<Vec3>> polys = polyhedronPolygons(faces);
+  if (polys.empty())
+    return AABB(); // Poliedro vazio
+
+  AABB box;
+  for (const auto &poly : polys)
+    for (const Vec3 &p : poly)
+      box.expand(p);
+
+  // Vértices na borda do cubo indicam um poliedro ilimitado
+  const double limit = L * 0.999;
+  if (box.min.x < -limit || box.min.y < -limit || box.min.z < -limit ||
+      box.max.x > limit || box.max.y > limit || box.max.z > limit)
+    return AABB::infinite();
+
+  // Folga contra erros de arredondamento do recorte
+  Vec3 pad = (box.max - box.min) * 1e-7 + Vec3(1e-9, 1e-9, 1e-9);
+  box.min = box.min - pad;
+  box.max = box.max + pad;
+  return box;
+}
+
+// Caixa de uma caixa transformada (envolve os 8 cantos)
+AABB transformBounds(const AABB &box, const Transform &t) {
+  if (box.isEmpty() || box.isInfinite())
+    return box;
+  AABB result;
+  for (int i = 0; i < 8; i++) {
+    Vec3 corner(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y,
+                i & 4 ? box.max.z : box.min.z);
+    result.expand(t.applyPoint(corner));
+  }
+  return result;
+}
+
+// Caixa de uma quádrica fechada (elipsoide), analisando os coeficientes.
+// Com Q(p) = p'Mp + 2b'p + J, a quádrica é um elipsoide quando M é definida
+// (positiva, ou negativa trocando o sinal de tudo); o centro é c = -M^-1 b,
+// o interior é (p - c)'M(p - c) <= r com r = -Q(c) e a meia-largura no eixo
+// i é sqrt(r (M^-1)_ii). As demais quádricas são ilimitadas.
+AABB quadricBounds(const Object &quad) {
+  double s = quad.A < 0 ? -1.0 : 1.0;
+  Transform m;
+  m.m[0][0] = s * quad.A;
+  m.m[1][1] = s * quad.B;
+  m.m[2][2] = s * quad.C;
+  m.m[0][1] = m.m[1][0] = s * quad.D * 0.5;
+  m.m[0][2] = m.m[2][0] = s * quad.E * 0.5;
+  m.m[1][2] = m.m[2][1] = s * quad.F * 0.5;
+
+  // Critério de Sylvester: menores principais positivos
+  double minor2 = m.m[0][0] * m.m[1][1] - m.m[0][1] * m.m[1][0];
+  double det = m.m[0][0] * (m.m[1][1] * m.m[2][2] - m.m[1][2] * m.m[2][1]) -
+               m.m[0][1] * (m.m[1][0] * m.m[2][2] - m.m[1][2] * m.m[2][0]) +
+               m.m[0][2] * (m.m[1][0] * m.m[2][1] - m.m[1][1] * m.m[2][0]);
+  if (!(m.m[0][0] > 0 && minor2 > 0 && det > 0))
+    return AABB::infinite();
+
+  Transform inv = m.inverse();
+  Vec3 b(s * quad.G * 0.5, s * quad.H * 0.5, s * quad.I * 0.5);
+  Vec3 c = inv.applyVector(b) * -1.0;
+  double r = -(b.dot(c) + s * quad.J);
+  if (r < 0)
+    return AABB(); // Elipsoide imaginário (vazio)
+
+  Vec3 half(sqrt(r * inv.m[0][0]), sqrt(r * inv.m[1][1]),
+            sqrt(r * inv.m[2][2]));
+  Vec3 pad = half * 1e-7 + Vec3(1e-9, 1e-9, 1e-9);
+  AABB box;
+  box.expand(c - half - pad);
+  box.expand(c + half + pad);
+  return box;
+}
+
+// Interseção de duas caixas (vazia se não se sobrepõem)
+AABB overlapBounds(const AABB &a, const AABB &b) {
+  AABB box;
+  box.min = Vec3(std::max(a.min.x, b.min.x), std::max(a.min.y, b.min.y),
+                 std::max(a.min.z, b.min.z));
+  box.max = Vec3(std::min(a.max.x, b.max.x), std::min(a.max.y, b.max.y),
+                 std::min(a.max.z, b.max.z));
+  if (box.min.x > box.max.x || box.min.y > box.max.y ||
+      box.min.z > box.max.z)
+    return AABB();
+  return box;
+}
+
+// Caixa de recorte vista pela BVH: coordenadas além de BOUNDS_LIMIT deixam o
+// eixo livre, de modo que uma fatia (slab) continua ilimitada
+AABB clipBounds(const AABB &clip) {
+  const double inf = std::numeric_limits<double>::infinity();
+  AABB box = clip;
+  double *lo[3] = {&box.min.x, &box.min.y, &box.min.z};
+  double *hi[3] = {&box.max.x, &box.max.y, &box.max.z};
+  for (int axis = 0; axis < 3; axis++) {
+    if (*lo[axis] <= -BOUNDS_LIMIT)
+      *lo[axis] = -inf;
+    if (*hi[axis] >= BOUNDS_LIMIT)
+      *hi[axis] = inf;
+  }
+  return box;
+}
+
+// Calcula a caixa delimitadora do objeto (e dos filhos de CSG)
+void computeBounds(Object &obj, const std::vector<Object> &prototypes) {
+  if (obj.type == SPHERE) {
+    Vec3 r(obj.radius, obj.radius, obj.radius);
+    obj.bounds = AABB();
+    obj.bounds.expand(obj.center - r);
+    obj.bounds.expand(obj.center + r);
+  } else if (obj.type == POLYHEDRON) {
+    obj.bounds = polyhedronBounds(obj.faces);
+  } else if (obj.type == QUADRIC) {
+    obj.bounds = overlapBounds(quadricBounds(obj), clipBounds(obj.clip));
+  } else if (obj.type == CSG) {
+    // O resultado está contido na união dos filhos positivos
+    obj.bounds = AABB();
+    bool unbounded = false;
+    for (size_t i = 0; i < obj.csgChildren.size(); i++) {
+      computeBounds(obj.csgChildren[i], prototypes);
+      const AABB &child = obj.csgChildren[i].bounds;
+      if (obj.csgOperations[i] != CSG_UNION || child.isEmpty())
+        continue;
+      if (child.isInfinite())
+        unbounded = true;
+      else
+        obj.bounds.expand(child);
+    }
+    if (unbounded)
+      obj.bounds = AABB::infinite();
+  } else if (obj.type == MESH) {
+    obj.bounds = AABB();
+    if (obj.mesh && !obj.mesh->bounds.isEmpty()) {
+      obj.bounds.min = obj.mesh->bounds.min + obj.meshOffset;
+      obj.bounds.max = obj.mesh->bounds.max + obj.meshOffset;
+    }
+  }
+}
+
+// Caixa da instância: a do protótipo (já calculada) transformada
+void computeBounds(Instance &inst, const std::vector<Object> &prototypes) {
+  inst.bounds =
+      transformBounds(prototypes[inst.prototypeIdx].bounds, inst.toWorld);
+}
+
+#endif
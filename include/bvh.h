@@ -0,0 +1,216 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "bounds.h"
+#include "structures.h"
+#include <algorithm>
+#include <vector>
+
+const int BVH_LEAF_SIZE = 4;    // Máximo de objetos por folha
+const int BVH_BINS = 12;        // Partições avaliadas pela heurística SAH
+const int BVH_SAH_DEPTH = 48;   // Abaixo disso divide pela mediana
+const int BVH_STACK_SIZE = 128; // Pilha da travessia (excede a profundidade)
+
+// Item da construção: caixa e centróide ficam junto do índice, para que as
+// partições percorram memória contígua em vez de saltar pelo vetor de caixas
+struct BVHBuildRef {
+  AABB box;
+  Vec3 centroid;
+  int index;
+};
+
+// Constrói recursivamente o nó sobre refs[first, first + count); refs traz
+// a caixa de cada índice (objeto ou triângulo). Os índices são copiados para
+// bvh.objects na ordem final (ver buildBVHFromRefs).
+int buildBVHNode(BVH &bvh, std::vector<BVHBuildRef> &refs, int first,
+                 int count, int depth) {
+  int nodeIdx = (int)bvh.nodes.size();
+  bvh.nodes.push_back(BVHNode());
+
+  AABB bounds, centroids;
+  for (int i = first; i < first + count; i++) {
+    bounds.expand(refs[i].box);
+    centroids.expand(refs[i].centroid);
+  }
+  bvh.nodes[nodeIdx].bounds = bounds;
+
+  if (count <= BVH_LEAF_SIZE) {
+    bvh.nodes[nodeIdx].first = first;
+    bvh.nodes[nodeIdx].count = count;
+    return nodeIdx;
+  }
+
+  // Escolhe o eixo de maior extensão dos centróides e divide por SAH binada
+  Vec3 extent = centroids.max - centroids.min;
+  int axis = 0;
+  if (extent.y > extent.x)
+    axis = 1;
+  if (extent.z > (axis == 0 ? extent.x : extent.y))
+    axis = 2;
+  auto coord = [axis](const Vec3 &v) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+  };
+
+  double cmin = coord(centroids.min);
+  double cext = coord(centroids.max) - cmin;
+  int mid = first + count / 2;
+
+  // Profundidade limitada: divisões SAH muito desbalanceadas dão lugar à
+  // mediana, garantindo que a pilha da travessia não transborde
+  if (cext > 0 && depth < BVH_SAH_DEPTH) {
+    auto binOf = [&](const BVHBuildRef &ref) {
+      int b = (int)(BVH_BINS * (coord(ref.centroid) - cmin) / cext);
+      return std::min(b, BVH_BINS - 1);
+    };
+
+    AABB binBounds[BVH_BINS];
+    int binCount[BVH_BINS] = {0};
+    for (int i = first; i < first + count; i++) {
+      int b = binOf(refs[i]);
+      binBounds[b].expand(refs[i].box);
+      binCount[b]++;
+    }
+
+    // Custo de cada divisão entre os bins [0, s) e [s, BVH_BINS): áreas e
+    // contagens do lado esquerdo acumuladas numa passada, o direito na volta
+    double leftArea[BVH_BINS];
+    int leftCount[BVH_BINS];
+    AABB left;
+    int nl = 0;
+    for (int split = 1; split < BVH_BINS; split++) {
+      left.expand(binBounds[split - 1]);
+      nl += binCount[split - 1];
+      leftArea[split] = left.surfaceArea();
+      leftCount[split] = nl;
+    }
+
+    // Empates ficam com a menor divisão
+    double bestCost = std::numeric_limits<double>::infinity();
+    int bestSplit = -1;
+    AABB right;
+    int nr = 0;
+    for (int split = BVH_BINS - 1; split >= 1; split--) {
+      right.expand(binBounds[split]);
+      nr += binCount[split];
+      if (leftCount[split] == 0 || nr == 0)
+        continue;
+      double cost = leftCount[split] * leftArea[split] +
+                    nr * right.surfaceArea();
+      if (cost <= bestCost) {
+        bestCost = cost;
+        bestSplit = split;
+      }
+    }
+
+    if (bestSplit > 0) {
+      BVHBuildRef *part = std::partition(
+          refs.data() + first, refs.data() + first + count,
+          [&](const BVHBuildRef &ref) { return binOf(ref) < bestSplit; });
+      mid = (int)(part - refs.data());
+    }
+  }
+
+  // Centróides coincidentes: divide pela mediana da ordem atual
+  if (mid == first || mid == first + count)
+    mid = first + count / 2;
+
+  // O filho esquerdo é sempre o nó seguinte (ordem de profundidade)
+  buildBVHNode(bvh, refs, first, mid - first, depth + 1);
+  int right = buildBVHNode(bvh, refs, mid, first + count - mid, depth + 1);
+
+  bvh.nodes[nodeIdx].first = right;
+  bvh.nodes[nodeIdx].count = 0;
+  return nodeIdx;
+}
+
+// Constrói a hierarquia sobre os itens e grava os índices na ordem das folhas
+void buildBVHFromRefs(BVH &bvh, std::vector<BVHBuildRef> &refs) {
+  if (refs.empty())
+    return;
+  buildBVHNode(bvh, refs, 0, (int)refs.size(), 0);
+  bvh.objects.resize(refs.size());
+  for (size_t i = 0; i < refs.size(); i++)
+    bvh.objects[i] = refs[i].index;
+}
+
+// Constrói a BVH sobre o subconjunto indices dos objetos e instâncias da
+// cena (caixas já calculadas). Objetos ilimitados (ex.: quádricas) ficam
+// fora da hierarquia e são sempre testados.
+void buildBVHOver(BVH &bvh, const Scene &scene,
+                  const std::vector<int> &indices) {
+  bvh.nodes.clear();
+  bvh.objects.clear();
+  bvh.unbounded.clear();
+
+  std::vector<BVHBuildRef> refs;
+  for (int i : indices) {
+    const AABB &b = sceneItem(scene, i).bounds;
+    if (b.isEmpty())
+      continue;
+    if (b.isInfinite())
+      bvh.unbounded.push_back(i);
+    else
+      refs.push_back({b, b.center(), i});
+  }
+  buildBVHFromRefs(bvh, refs);
+}
+
+// Constrói a BVH sobre os triângulos da malha (e a caixa da malha)
+void buildMeshBVH(Mesh &mesh) {
+  BVH &bvh = mesh.bvh;
+  bvh.nodes.clear();
+  bvh.objects.clear();
+  bvh.unbounded.clear();
+  mesh.bounds = AABB();
+
+  std::vector<BVHBuildRef> refs(mesh.triangleCount());
+  for (size_t i = 0; i < refs.size(); i++) {
+    AABB &box = refs[i].box;
+    for (int k = 0; k < 3; k++)
+      box.expand(mesh.vertices[mesh.indices[3 * i + k]]);
+    refs[i].centroid = box.center();
+    refs[i].index = (int)i;
+    mesh.bounds.expand(box);
+  }
+  buildBVHFromRefs(bvh, refs);
+}
+
+// Calcula as caixas dos objetos e constrói a BVH da cena
+void buildBVH(Scene &scene) {
+  for (Object &proto : scene.prototypes)
+    computeBounds(proto, scene.prototypes);
+  for (Object &obj : scene.objects)
+    computeBounds(obj, scene.prototypes);
+  for (Instance &inst : scene.instances)
+    computeBounds(inst, scene.prototypes);
+
+  std::vector<int> indices(sceneItemCount(scene));
+  for (size_t i = 0; i < indices.size(); i++)
+    indices[i] = (int)i;
+  buildBVHOver(scene.bvh, scene, indices);
+}
+
+// Atualiza as caixas da BVH após objetos se moverem, sem reconstruir a
+// topologia. Filhos sempre têm índice maior que o pai, então basta percorrer
+// os nós de trás para frente.
+void refitBVH(Scene &scene) {
+  for (Object &obj : scene.objects)
+    computeBounds(obj, scene.prototypes);
+  for (Instance &inst : scene.instances)
+    computeBounds(inst, scene.prototypes);
+
+  BVH &bvh = scene.bvh;
+  for (int i = (int)bvh.nodes.size() - 1; i >= 0; i--) {
+    BVHNode &node = bvh.nodes[i];
+    node.bounds = AABB();
+    if (node.count > 0) {
+      for (int j = node.first; j < node.first + node.count; j++)
+        node.bounds.expand(sceneItem(scene, bvh.objects[j]).bounds);
+    } else {
+      node.bounds.expand(bvh.nodes[i + 1].bounds);
+      node.bounds.expand(bvh.nodes[node.first].bounds);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+// Cache com política LRU (menos recentemente usado é descartado primeiro).
+// Não é sincronizado: deve ser usado por uma única thread.
+template <typename Key, typename Value> class LRUCache {
+public:
+  explicit LRUCache(size_t capacity) : capacity(capacity) {}
+
+  // Busca um valor e o marca como usado mais recentemente
+  bool get(const Key &key, Value &value) {
+    auto it = index.find(key);
+    if (it == index.end())
+      return false;
+    entries.splice(entries.begin(), entries, it->second);
+    value = it->second->second;
+    return true;
+  }
+
+  // Insere ou substitui um valor, descartando o mais antigo se necessário
+  void put(const Key &key, const Value &value) {
+    auto it = index.find(key);
+    if (it != index.end()) {
+      it->second->second = value;
+      entries.splice(entries.begin(), entries, it->second);
+      return;
+    }
+
+    entries.emplace_front(key, value);
+    index[key] = entries.begin();
+
+    while (entries.size() > capacity && !entries.empty()) {
+      index.erase(entries.back().first);
+      entries.pop_back();
+    }
+  }
+
+  size_t size() const { return entries.size(); }
+
+private:
+  size_t capacity;
+  std::list<std::pair<Key, Value>> entries;
+  std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator>
+      index;
+};
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include "vec3.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Id de pixel cujas amostras atingem objetos diferentes (borda)
+const int AOV_MIXED = -2;
+
+// Buffers auxiliares (AOVs) do primeiro hit de cada pixel
+struct AOVBuffers {
+  int width, height;
+  std::vector<Vec3> color;      // Cor média das amostras (sem quantização)
+  std::vector<double> variance; // Variância da luminância média do pixel
+  std::vector<Vec3> albedo;     // Cor do pigmento no primeiro hit
+  std::vector<Vec3> normal;     // Normal no primeiro hit
+  std::vector<double> depth;    // Distância da câmera ao primeiro hit
+  std::vector<int> objectId;    // Objeto do primeiro hit (-1 = fundo)
+
+  AOVBuffers() : width(0), height(0) {}
+
+  void resize(int w, int h) {
+    width = w;
+    height = h;
+    color.assign(w * h, Vec3(0, 0, 0));
+    variance.assign(w * h, 0.0);
+    albedo.assign(w * h, Vec3(0, 0, 0));
+    normal.assign(w * h, Vec3(0, 0, 0));
+    depth.assign(w * h, 0.0);
+    objectId.assign(w * h, -1);
+  }
+};
+
+// Luminância de uma cor RGB linear
+double luminance(const Vec3 &c) {
+  return 0.2126 * c.x + 0.7152 * c.y + 0.0722 * c.z;
+}
+
+// Albedo usado para separar a iluminação da textura (evita divisão por zero)
+Vec3 demodulationAlbedo(const Vec3 &albedo) {
+  const double minAlbedo = 0.05;
+  return Vec3(std::max(albedo.x, minAlbedo), std::max(albedo.y, minAlbedo),
+              std::max(albedo.z, minAlbedo));
+}
+
+// Parâmetros das funções de parada de borda do filtro
+const int DENOISE_ITERATIONS = 5;
+const double DENOISE_SIGMA_LUMINANCE = 4.0; // Em desvios padrão do ruído
+const double DENOISE_SIGMA_ALBEDO = 0.1;    // Diferença de albedo
+const double DENOISE_SIGMA_DEPTH = 0.02;    // Diferença relativa de distância
+const double DENOISE_NORMAL_POWER = 32;     // Expoente do cosseno das normais
+
+// Filtro à-trous (wavelet) guiado pelos AOVs (Dammertz et al. 2010).
+// Cada iteração aplica o núcleo B3-spline 5x5 com passo 2^i, ponderado pela
+// semelhança de albedo, normal, profundidade e objeto entre os pixels. A
+// diferença de luminância é medida em relação ao ruído estimado do pixel
+// (como no SVGF), preservando detalhes sem ruído como reflexos nítidos.
+void denoiseAtrous(AOVBuffers &aov) {
+  const double kernel[3] = {3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0};
+  const int width = aov.width;
+  const int height = aov.height;
+
+  // Filtra a iluminação (cor / albedo) para preservar texturas do primeiro hit
+  std::vector<Vec3> input(aov.color.size());
+  std::vector<Vec3> output(input.size());
+  std::vector<double> variance = aov.variance;
+  for (size_t p = 0; p < input.size(); p++) {
+    Vec3 albedo = demodulationAlbedo(aov.albedo[p]);
+    input[p] =
+        aov.color[p] * Vec3(1.0 / albedo.x, 1.0 / albedo.y, 1.0 / albedo.z);
+    variance[p] /= luminance(albedo) * luminance(albedo);
+  }
+  std::vector<double> nextVariance(variance.size());
+
+  for (int iter = 0; iter < DENOISE_ITERATIONS; iter++) {
+    int step = 1 << iter;
+
+#pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        int p = y * width + x;
+        const Vec3 &cp = input[p];
+
+        // Bordas já estão suavizadas pela superamostragem
+        if (aov.objectId[p] == AOV_MIXED) {
+          output[p] = cp;
+          nextVariance[p] = variance[p];
+          continue;
+        }
+
+        double lp = luminance(cp);
+        double sigmaL = DENOISE_SIGMA_LUMINANCE * sqrt(variance[p]) + 1e-4;
+        Vec3 sum(0, 0, 0);
+        double weightSum = 0.0, varianceSum = 0.0;
+
+        for (int dy = -2; dy <= 2; dy++) {
+          int qy = y + dy * step;
+          if (qy < 0 || qy >= height)
+            continue;
+          for (int dx = -2; dx <= 2; dx++) {
+            int qx = x + dx * step;
+            if (qx < 0 || qx >= width)
+              continue;
+            int q = qy * width + qx;
+
+            // Objetos diferentes nunca se misturam
+            if (aov.objectId[q] != aov.objectId[p])
+              continue;
+
+            double h = kernel[std::abs(dx)] * kernel[std::abs(dy)];
+
+            double wColor = exp(-fabs(luminance(input[q]) - lp) / sigmaL);
+
+            Vec3 da = aov.albedo[q] - aov.albedo[p];
+            double wAlbedo = exp(-da.dot(da) / (DENOISE_SIGMA_ALBEDO *
+                                                DENOISE_SIGMA_ALBEDO));
+
+            double wNormal = 1.0;
+            double wDepth = 1.0;
+            if (aov.objectId[p] >= 0) {
+              double cosNormal = aov.normal[p].dot(aov.normal[q]);
+              wNormal = pow(std::max(0.0, cosNormal), DENOISE_NORMAL_POWER);
+
+              double dz = fabs(aov.depth[q] - aov.depth[p]);
+              wDepth = exp(-dz / (DENOISE_SIGMA_DEPTH * step * aov.depth[p] +
+                                  1e-6));
+            }
+
+            double w = h * wColor * wAlbedo * wNormal * wDepth;
+            sum = sum + input[q] * w;
+            weightSum += w;
+            varianceSum += w * w * variance[q];
+          }
+        }
+
+        // O próprio pixel tem peso 1 em todos os termos, logo weightSum > 0
+        output[p] = sum / weightSum;
+        nextVariance[p] = varianceSum / (weightSum * weightSum);
+      }
+    }
+
+    std::swap(input, output);
+    std::swap(variance, nextVariance);
+  }
+
+  for (size_t p = 0; p < input.size(); p++)
+    aov.color[p] = input[p] * demodulationAlbedo(aov.albedo[p]);
+}
+
+#endif
@@ -0,0 +1,514 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "denoise.h"
+#include "lights.h"
+#include "loader.h"
+#include "optimize.h"
+#include "reach.h"
+#include "render.h"
+#include "structures.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Renderização incremental: a cada execução o estado da anterior (imagem,
+// objeto do primeiro hit de cada pixel e as dependências de cada bloco) é
+// comparado com a cena editada, e só os blocos afetados são refeitos. Como
+// o amostrador depende só do pixel, o resultado é idêntico ao de uma
+// renderização completa da cena editada.
+
+const char RENDER_STATE_MAGIC[] = "RTSTATE1";
+const double REACH_PADDING = 0.1; // Folga da grade, em frações da cena
+
+// Estado salvo entre renderizações
+struct RenderState {
+  RenderSettings settings;
+  ReachGrid grid;
+  std::string sceneText;                // Cena usada, para a comparação
+  std::vector<std::string> textureKeys; // Versão de cada textura (ou "")
+  std::vector<unsigned char> frameBuffer;
+  std::vector<int> objectId; // Objeto do primeiro hit (ver AOVBuffers)
+  std::vector<TileRecord> records; // Um por bloco de tileGrid
+};
+
+// O que a renderização incremental refez
+struct IncrementalReport {
+  std::string fullReason; // Vazio se a imagem anterior foi aproveitada
+  int tiles;
+  int fullTiles;
+  int partialTiles;
+  long pixels;
+
+  IncrementalReport() : tiles(0), fullTiles(0), partialTiles(0), pixels(0) {}
+};
+
+// Região da grade de alcance: objetos limitados, olho e cubos das luzes,
+// com folga para edições perto da borda. Objetos ilimitados ficam de fora;
+// os segmentos que saem da grade só são registrados até a borda.
+AABB reachRegion(const Scene &scene) {
+  AABB region;
+  region.expand(scene.eye);
+  for (int i = 0; i < sceneItemCount(scene); i++) {
+    const AABB &bounds = sceneItem(scene, i).bounds;
+    if (!bounds.isEmpty() && !bounds.isInfinite())
+      region.expand(bounds);
+  }
+  Vec3 r(LIGHT_RADIUS, LIGHT_RADIUS, LIGHT_RADIUS);
+  for (size_t i = 1; i < scene.lights.size(); i++) {
+    region.expand(scene.lights[i].position - r);
+    region.expand(scene.lights[i].position + r);
+  }
+
+  Vec3 size = region.max - region.min;
+  double extent = std::max(size.x, std::max(size.y, size.z));
+  double pad = std::max(1e-3, REACH_PADDING * extent);
+  region.min = region.min - Vec3(pad, pad, pad);
+  region.max = region.max + Vec3(pad, pad, pad);
+  return region;
+}
+
+// Versão de cada textura (muda quando o arquivo é modificado)
+std::vector<std::string> textureKeys(const Scene &scene) {
+  std::vector<std::string> keys;
+  for (const Pigment &pigment : scene.pigments)
+    keys.push_back(pigment.type == TEXMAP ? fileCacheKey(pigment.texturePath)
+                                          : "");
+  return keys;
+}
+
+bool sameVec(const Vec3 &a, const Vec3 &b) {
+  return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+bool sameBox(const AABB &a, const AABB &b) {
+  return sameVec(a.min, b.min) && sameVec(a.max, b.max);
+}
+
+bool samePigment(const Pigment &a, const std::string &keyA, const Pigment &b,
+                 const std::string &keyB) {
+  if (a.type != b.type || keyA != keyB)
+    return false;
+  if (a.type == TEXMAP) {
+    for (int i = 0; i < 4; i++)
+      if (a.p0[i] != b.p0[i] || a.p1[i] != b.p1[i])
+        return false;
+    return a.texturePath == b.texturePath;
+  }
+  if (a.type == CHECKER &&
+      (!sameVec(a.color2, b.color2) || a.scale != b.scale))
+    return false;
+  return sameVec(a.color1, b.color1);
+}
+
+bool sameFinish(const Finish &a, const Finish &b) {
+  return a.ka == b.ka && a.kd == b.kd && a.ks == b.ks && a.alpha == b.alpha &&
+         a.kr == b.kr && a.kt == b.kt && a.ior == b.ior;
+}
+
+// Mesma geometria (os filhos de um CSG também comparam pigmento e
+// acabamento, por segurança)
+bool sameGeometry(const Object &a, const Object &b) {
+  if (a.type != b.type)
+    return false;
+  switch (a.type) {
+  case SPHERE:
+    return sameVec(a.center, b.center) && a.radius == b.radius;
+  case POLYHEDRON:
+    if (a.faces.size() != b.faces.size())
+      return false;
+    for (size_t i = 0; i < a.faces.size(); i++) {
+      const Plane &p = a.faces[i], &q = b.faces[i];
+      if (p.a != q.a || p.b != q.b || p.c != q.c || p.d != q.d)
+        return false;
+    }
+    return true;
+  case QUADRIC:
+    return a.A == b.A && a.B == b.B && a.C == b.C && a.D == b.D &&
+           a.E == b.E && a.F == b.F && a.G == b.G && a.H == b.H &&
+           a.I == b.I && a.J == b.J && sameBox(a.clip, b.clip);
+  case CSG:
+    if (a.csgChildren.size() != b.csgChildren.size() ||
+        a.csgOperations != b.csgOperations)
+      return false;
+    for (size_t i = 0; i < a.csgChildren.size(); i++) {
+      const Object &p = a.csgChildren[i], &q = b.csgChildren[i];
+      if (p.pigmentIdx != q.pigmentIdx || p.finishIdx != q.finishIdx ||
+          !sameGeometry(p, q))
+        return false;
+    }
+    return true;
+  case MESH:
+    // A chave muda quando o arquivo OBJ é modificado
+    return sameVec(a.meshOffset, b.meshOffset) &&
+           (a.mesh == b.mesh ||
+            (a.mesh && b.mesh && a.mesh->key == b.mesh->key));
+  default:
+    return false;
+  }
+}
+
+bool sameGeometry(const Instance &a, const Instance &b) {
+  if (a.prototypeIdx != b.prototypeIdx)
+    return false;
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 4; j++)
+      if (a.toWorld.m[i][j] != b.toWorld.m[i][j])
+        return false;
+  return true;
+}
+
+// Mesma geometria do item i nas duas cenas (objeto ou instância nas duas)
+bool sameItemGeometry(const Scene &a, const Scene &b, int i) {
+  int objectsA = (int)a.objects.size(), objectsB = (int)b.objects.size();
+  if ((i < objectsA) != (i < objectsB))
+    return false;
+  if (i < objectsA)
+    return sameGeometry(a.objects[i], b.objects[i]);
+  return sameGeometry(a.instances[i - objectsA], b.instances[i - objectsB]);
+}
+
+// Câmera, luzes e protótipos: qualquer mudança afeta a imagem inteira
+bool sameView(const Scene &a, const Scene &b) {
+  if (!sameVec(a.eye, b.eye) || !sameVec(a.lookAt, b.lookAt) ||
+      !sameVec(a.up, b.up) || a.fovy != b.fovy ||
+      a.lights.size() != b.lights.size() ||
+      a.prototypes.size() != b.prototypes.size())
+    return false;
+  for (size_t i = 0; i < a.lights.size(); i++) {
+    const Light &p = a.lights[i], &q = b.lights[i];
+    if (!sameVec(p.position, q.position) || !sameVec(p.color, q.color) ||
+        !sameVec(p.attenuation, q.attenuation))
+      return false;
+  }
+  for (size_t i = 0; i < a.prototypes.size(); i++) {
+    const Object &p = a.prototypes[i], &q = b.prototypes[i];
+    if (p.pigmentIdx != q.pigmentIdx || p.finishIdx != q.finishIdx ||
+        !sameGeometry(p, q))
+      return false;
+  }
+  return true;
+}
+
+// Parâmetros que mudam os pixels (o piloto só muda a ordem dos blocos)
+bool sameRenderSettings(const RenderSettings &a, const RenderSettings &b) {
+  return a.width == b.width && a.height == b.height &&
+         a.samples == b.samples && a.aperture == b.aperture &&
+         a.focusDist == b.focusDist && a.sampler == b.sampler &&
+         a.seed == b.seed &&
+         a.shading.lightSamples == b.shading.lightSamples;
+}
+
+// Compara a cena anterior com a editada. Objetos com material alterado vão
+// para changed (ordenado); para cada objeto com geometria alterada, criado
+// ou removido, as caixas antiga e nova vão para moved. Retorna false (com o
+// motivo) se a imagem inteira precisa ser refeita.
+bool diffScenes(const Scene &before, const std::vector<std::string> &keysBefore,
+                const Scene &after, const std::vector<std::string> &keysAfter,
+                const ReachGrid &grid, std::vector<int> &changed,
+                std::vector<AABB> &moved, std::string &reason) {
+  if (!sameView(before, after)) {
+    reason = "câmera, luzes ou protótipos alterados";
+    return false;
+  }
+
+  int countBefore = sceneItemCount(before), countAfter = sceneItemCount(after);
+  for (int i = 0; i < std::max(countBefore, countAfter); i++) {
+    if (i >= countBefore) {
+      moved.push_back(sceneItem(after, i).bounds);
+      continue;
+    }
+    if (i >= countAfter) {
+      moved.push_back(sceneItem(before, i).bounds);
+      continue;
+    }
+    const SceneItem &a = sceneItem(before, i), &b = sceneItem(after, i);
+    if (!sameItemGeometry(before, after, i)) {
+      moved.push_back(a.bounds);
+      moved.push_back(b.bounds);
+      continue;
+    }
+    if (!samePigment(before.pigments[a.pigmentIdx], keysBefore[a.pigmentIdx],
+                     after.pigments[b.pigmentIdx], keysAfter[b.pigmentIdx]) ||
+        !sameFinish(before.finishes[a.finishIdx], after.finishes[b.finishIdx]))
+      changed.push_back(i);
+  }
+
+  // Só a parte dos segmentos dentro da grade foi registrada
+  for (const AABB &box : moved) {
+    if (box.isEmpty())
+      continue;
+    if (box.isInfinite() || !grid.box.contains(box.min) ||
+        !grid.box.contains(box.max)) {
+      reason = "geometria alterada fora da grade de alcance";
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T> void writeValue(std::ostream &out, const T &value) {
+  out.write((const char *)&value, sizeof(T));
+}
+
+template <typename T> bool readValue(std::istream &in, T &value) {
+  return (bool)in.read((char *)&value, sizeof(T));
+}
+
+template <typename T>
+void writeArray(std::ostream &out, const std::vector<T> &values) {
+  writeValue(out, (uint64_t)values.size());
+  out.write((const char *)values.data(), values.size() * sizeof(T));
+}
+
+template <typename T> bool readArray(std::istream &in, std::vector<T> &values) {
+  uint64_t size;
+  if (!readValue(in, size))
+    return false;
+  values.resize(size);
+  return (bool)in.read((char *)values.data(), size * sizeof(T));
+}
+
+void writeString(std::ostream &out, const std::string &text) {
+  writeArray(out, std::vector<char>(text.begin(), text.end()));
+}
+
+bool readString(std::istream &in, std::string &text) {
+  std::vector<char> chars;
+  if (!readArray(in, chars))
+    return false;
+  text.assign(chars.begin(), chars.end());
+  return true;
+}
+
+// Salva o estado em formato binário (válido só na mesma máquina)
+bool saveRenderState(const std::string &filename, const RenderState &state) {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Erro: Não foi possível criar o arquivo de estado "
+              << filename << std::endl;
+    return false;
+  }
+
+  const RenderSettings &s = state.settings;
+  file.write(RENDER_STATE_MAGIC, sizeof(RENDER_STATE_MAGIC));
+  writeValue(file, s.width);
+  writeValue(file, s.height);
+  writeValue(file, s.samples);
+  writeValue(file, s.aperture);
+  writeValue(file, s.focusDist);
+  writeValue(file, s.sampler);
+  writeValue(file, s.seed);
+  writeValue(file, s.shading.lightSamples);
+  writeValue(file, state.grid.box);
+
+  writeString(file, state.sceneText);
+  writeValue(file, (uint64_t)state.textureKeys.size());
+  for (const std::string &key : state.textureKeys)
+    writeString(file, key);
+  writeArray(file, state.frameBuffer);
+  writeArray(file, state.objectId);
+
+  writeValue(file, (uint64_t)state.records.size());
+  for (const TileRecord &record : state.records) {
+    writeArray(file, record.firstHits);
+    writeArray(file, record.objects);
+    std::vector<uint64_t> words(REACH_CELLS / 64, 0);
+    for (int c = 0; c < REACH_CELLS; c++)
+      if (record.cells.test(c))
+        words[c / 64] |= (uint64_t)1 << (c % 64);
+    writeArray(file, words);
+  }
+  return (bool)file;
+}
+
+// Lê o estado; falha silenciosamente se não existe (primeira execução)
+bool loadRenderState(const std::string &filename, RenderState &state) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open())
+    return false;
+
+  char magic[sizeof(RENDER_STATE_MAGIC)];
+  if (!file.read(magic, sizeof(magic)) ||
+      std::string(magic) != RENDER_STATE_MAGIC) {
+    std::cerr << "Erro: Arquivo de estado inválido " << filename << std::endl;
+    return false;
+  }
+
+  RenderSettings &s = state.settings;
+  AABB box;
+  readValue(file, s.width);
+  readValue(file, s.height);
+  readValue(file, s.samples);
+  readValue(file, s.aperture);
+  readValue(file, s.focusDist);
+  readValue(file, s.sampler);
+  readValue(file, s.seed);
+  readValue(file, s.shading.lightSamples);
+  readValue(file, box);
+  state.grid = ReachGrid(box);
+
+  uint64_t count = 0;
+  bool ok = readString(file, state.sceneText) && readValue(file, count);
+  state.textureKeys.resize(ok ? count : 0);
+  for (std::string &key : state.textureKeys)
+    ok = ok && readString(file, key);
+  ok = ok && readArray(file, state.frameBuffer) &&
+       readArray(file, state.objectId) && readValue(file, count);
+  state.records.resize(ok ? count : 0);
+  for (TileRecord &record : state.records) {
+    std::vector<uint64_t> words;
+    ok = ok && readArray(file, record.firstHits) &&
+         readArray(file, record.objects) && readArray(file, words) &&
+         words.size() == REACH_CELLS / 64;
+    for (int c = 0; ok && c < REACH_CELLS; c++)
+      record.cells[c] = (words[c / 64] >> (c % 64)) & 1;
+  }
+  if (!ok)
+    std::cerr << "Erro: Arquivo de estado corrompido " << filename
+              << std::endl;
+  return ok;
+}
+
+// Lê a cena anterior guardada no estado, com as mesmas otimizações
+bool loadPreviousScene(const RenderState &state,
+                       const OptimizeOptions *optimize, Scene &scene) {
+  std::istringstream text(state.sceneText);
+  if (!loadScene(text, scene))
+    return false;
+  if (optimize)
+    optimizeScene(scene, *optimize);
+  return scene.pigments.size() == state.textureKeys.size();
+}
+
+// Renderiza a cena aproveitando o estado salvo em statePath, que é então
+// atualizado. sceneText é o texto de onde scene foi lida e optimize as
+// opções do otimizador aplicadas a ela (nulo = sem otimização), que não
+// pode remover objetos: os registros se referem aos objetos pelo índice.
+//
+// Um bloco é refeito por inteiro se algum raio secundário dele atingiu um
+// objeto com material alterado, ou se algum segmento registrado cruzou a
+// caixa antiga ou nova de um objeto com geometria alterada. Se o objeto só
+// foi visto no primeiro hit, basta refazer os pixels em que ele foi o
+// primeiro hit (ou que misturam objetos).
+bool renderIncremental(const Scene &scene, const std::string &sceneText,
+                       const OptimizeOptions *optimize,
+                       const RenderSettings &settings,
+                       const std::string &statePath,
+                       std::vector<unsigned char> &frameBuffer,
+                       IncrementalReport &report) {
+  std::vector<Tile> tiles = tileGrid(settings);
+  std::vector<std::string> keys = textureKeys(scene);
+  report = IncrementalReport();
+  report.tiles = (int)tiles.size();
+
+  RenderState state;
+  Scene previous;
+  std::vector<int> changed;
+  std::vector<AABB> moved;
+  if (!loadRenderState(statePath, state))
+    report.fullReason = "sem estado anterior";
+  else if (!sameRenderSettings(state.settings, settings))
+    report.fullReason = "parâmetros de renderização alterados";
+  else if (state.records.size() != tiles.size() ||
+           !loadPreviousScene(state, optimize, previous))
+    report.fullReason = "estado anterior incompatível";
+  else
+    diffScenes(previous, state.textureKeys, scene, keys, state.grid, changed,
+               moved, report.fullReason);
+
+  AOVBuffers aov;
+  aov.resize(settings.width, settings.height);
+
+  if (!report.fullReason.empty()) {
+    state.grid = ReachGrid(reachRegion(scene));
+    state.records.assign(tiles.size(), TileRecord());
+    renderPixels(scene, settings, frameBuffer, &aov, tiles, nullptr,
+                 &state.records, &state.grid);
+    report.fullTiles = report.tiles;
+    report.pixels = (long)settings.width * settings.height;
+  } else {
+    frameBuffer = state.frameBuffer;
+    aov.objectId = state.objectId;
+    std::sort(changed.begin(), changed.end());
+
+    auto anyChanged = [&changed](const std::vector<int> &objects) {
+      for (int idx : changed)
+        if (std::binary_search(objects.begin(), objects.end(), idx))
+          return true;
+      return false;
+    };
+
+    std::vector<Tile> dirty;
+    std::vector<int> dirtyIndex;
+    std::vector<bool> dirtyFull;
+    std::vector<char> mask(settings.width * settings.height, 0);
+    for (size_t t = 0; t < tiles.size(); t++) {
+      const Tile &tile = tiles[t];
+      const TileRecord &record = state.records[t];
+      bool full = anyChanged(record.objects);
+      for (size_t k = 0; !full && k < moved.size(); k++)
+        full = !moved[k].isEmpty() && record.touches(state.grid, moved[k]);
+      if (!full && !anyChanged(record.firstHits))
+        continue;
+
+      long pixels = 0;
+      for (int y = tile.y0; y < tile.y1; y++) {
+        for (int x = tile.x0; x < tile.x1; x++) {
+          int p = y * settings.width + x;
+          int id = aov.objectId[p];
+          if (full || id == AOV_MIXED ||
+              std::binary_search(changed.begin(), changed.end(), id)) {
+            mask[p] = 1;
+            pixels++;
+          }
+        }
+      }
+      report.pixels += pixels;
+      (full ? report.fullTiles : report.partialTiles)++;
+      dirty.push_back(tile);
+      dirtyIndex.push_back((int)t);
+      dirtyFull.push_back(full);
+    }
+
+    std::vector<TileRecord> records(dirty.size());
+    if (!dirty.empty())
+      renderPixels(scene, settings, frameBuffer, &aov, dirty, nullptr,
+                   &records, &state.grid, &mask);
+
+    // Blocos refeitos em parte guardam também as dependências antigas dos
+    // pixels que não mudaram
+    for (size_t k = 0; k < dirty.size(); k++) {
+      TileRecord &record = state.records[dirtyIndex[k]];
+      if (dirtyFull[k])
+        record = records[k];
+      else
+        record.merge(records[k]);
+    }
+  }
+
+  state.settings = settings;
+  state.sceneText = sceneText;
+  state.textureKeys = keys;
+  state.frameBuffer = frameBuffer;
+  state.objectId = aov.objectId;
+  return saveRenderState(statePath, state);
+}
+
+// Resumo para o usuário
+void printIncrementalReport(const IncrementalReport &report,
+                            std::ostream &out) {
+  if (!report.fullReason.empty()) {
+    out << "Renderização completa (" << report.fullReason << ")" << std::endl;
+    return;
+  }
+  out << "Renderização incremental: " << report.fullTiles << " blocos inteiros"
+      << " e " << report.partialTiles << " em parte, de " << report.tiles
+      << " (" << report.pixels << " pixels)" << std::endl;
+}
+
+#endif
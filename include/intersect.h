@@ -1,6 +1,7 @@
 #ifndef INTERSECT_H
 #define INTERSECT_H
 
+#include "bvh.h"
 #include "structures.h"
 #include <algorithm>
 #include <cmath>
@@ -8,12 +9,44 @@
 #include <limits>
 #include <vector>
 
-// Checa se o raio intersecta a esfera
-bool intersectSphere(const Ray &ray, const Object &sphere, HitInfo &hit) {
-  Vec3 oc = ray.origin - sphere.center;
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// A interseção é feita em duas fases: os testes abaixo calculam apenas a
+// distância t e o necessário para reconstruir a superfície atingida
+// (HitCandidate); ponto e normal são calculados por finalizeHit somente para
+// o candidato mais próximo.
+
+// Termos da interseção que dependem apenas da origem do raio. Raios
+// primários sem DOF partem todos do olho, então esses termos são calculados
+// uma vez por renderização (ver buildOriginCache).
+struct OriginTerms {
+  Vec3 oc;       // Esfera: origem - centro; quádrica: gradiente na origem
+  double c;      // Esfera: oc·oc - r²; quádrica: valor na origem
+  int firstFace; // Poliedro: primeira distância em OriginCache::faceDistances
+};
+
+struct OriginCache {
+  Vec3 origin;
+  std::vector<OriginTerms> objects;  // Por objeto da cena
+  std::vector<double> faceDistances; // Distância da origem a cada face
+};
+
+// Checa se o raio intersecta a esfera (terms: termos da origem, opcional)
+bool intersectSphere(const Ray &ray, const Object &sphere, HitCandidate &hit,
+                     const OriginTerms *terms = nullptr) {
+  Vec3 oc;
+  double c;
+  if (terms) {
+    oc = terms->oc;
+    c = terms->c;
+  } else {
+    oc = ray.origin - sphere.center;
+    c = oc.dot(oc) - sphere.radius * sphere.radius;
+  }
   double a = ray.direction.dot(ray.direction);
   double b = 2.0 * oc.dot(ray.direction);
-  double c = oc.dot(oc) - sphere.radius * sphere.radius;
   double discriminant = b * b - 4 * a * c;
 
   if (discriminant < 0)
@@ -28,91 +61,261 @@ bool intersectSphere(const Ray &ray, const Object &sphere, HitInfo &hit) {
   if (t < 0.001)
     return false;
 
-  hit.hit = true;
-  hit.t = t;
-  hit.point = ray.at(t);
-  hit.normal = (hit.point - sphere.center).normalize();
-
+  hit = HitCandidate(t, &sphere);
   return true;
 }
 
-// Checa se o raio intersecta o poliedro
-bool intersectPolyhedron(const Ray &ray, const Object &poly, HitInfo &hit) {
-  double tNear = -std::numeric_limits<double>::infinity();
-  double tFar = std::numeric_limits<double>::infinity();
-  Vec3 nearNormal(0, 0, 0), farNormal(0, 0, 0);
+const size_t POLY_BOUNDS_MIN_FACES = 8; // Abaixo disso a caixa não compensa
+
+// Rejeição antecipada pela caixa do poliedro (só para muitas faces: com
+// poucas, recortar direto é mais barato que o teste da caixa). Como a caixa
+// é testada a partir de t = 0, só são rejeitados poliedros inteiramente
+// atrás da origem ou fora do raio.
+bool missesPolyhedronBounds(const Ray &ray, const Object &poly) {
+  if (poly.faces.size() < POLY_BOUNDS_MIN_FACES || poly.bounds.isInfinite())
+    return false;
+  Vec3 invDir(1.0 / ray.direction.x, 1.0 / ray.direction.y,
+              1.0 / ray.direction.z);
+  double tEnter;
+  return !poly.bounds.intersect(ray.origin, invDir,
+                                std::numeric_limits<double>::infinity(),
+                                tEnter);
+}
+
+#ifdef __SSE2__
+// Cada registrador SSE2 (presente em todo x86-64) guarda 2 faces; um bloco
+// de POLY_LANES faces ocupa POLY_VECTORS registradores
+const int POLY_VECTORS = POLY_LANES / 2;
+
+// Escolhe a lane de a onde mask está ligada e a de b nas demais, sem desvios
+__m128d selectLanes(__m128d mask, __m128d a, __m128d b) {
+  return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+// Recorta o raio pelos semi-espaços do poliedro, POLY_LANES faces por vez.
+// Cada lane mantém o maior t de entrada e o menor t de saída das suas faces
+// (com os índices guardados como double); as lanes são reduzidas no final.
+// originDistances (opcional) traz as distâncias da origem a cada face.
+// Retorna false se o raio não cruza o poliedro; senão devolve o intervalo
+// [tNear, tFar] e as faces de cada ponta.
+bool clipPolyhedron(const Ray &ray, const Object &poly,
+                    const double *originDistances, double &tNear,
+                    int &nearFace, double &tFar, int &farFace) {
+  const FaceArrays &f = poly.faceArrays;
+  const double inf = std::numeric_limits<double>::infinity();
+
+  const __m128d ox = _mm_set1_pd(ray.origin.x);
+  const __m128d oy = _mm_set1_pd(ray.origin.y);
+  const __m128d oz = _mm_set1_pd(ray.origin.z);
+  const __m128d dx = _mm_set1_pd(ray.direction.x);
+  const __m128d dy = _mm_set1_pd(ray.direction.y);
+  const __m128d dz = _mm_set1_pd(ray.direction.z);
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d eps = _mm_set1_pd(1e-10);
+  const __m128d negEps = _mm_set1_pd(-1e-10);
+  const __m128d signBit = _mm_set1_pd(-0.0);
+
+  __m128d nearT[POLY_VECTORS], farT[POLY_VECTORS];
+  __m128d nearIdx[POLY_VECTORS], farIdx[POLY_VECTORS];
+  for (int v = 0; v < POLY_VECTORS; v++) {
+    nearT[v] = _mm_set1_pd(-inf);
+    farT[v] = _mm_set1_pd(inf);
+    nearIdx[v] = farIdx[v] = _mm_set1_pd(-1);
+  }
 
-  for (const Plane &plane : poly.faces) {
-    Vec3 n = plane.normal();
-    double denom = n.dot(ray.direction);
-    double dist = -plane.distance(ray.origin) / denom;
+  int count = (int)f.a.size();
+  for (int base = 0; base < count; base += POLY_LANES) {
+    __m128d outside = zero;
+    for (int v = 0; v < POLY_VECTORS; v++) {
+      int i = base + 2 * v;
+      __m128d a = _mm_loadu_pd(&f.a[i]);
+      __m128d b = _mm_loadu_pd(&f.b[i]);
+      __m128d c = _mm_loadu_pd(&f.c[i]);
+      __m128d originDist;
+      if (originDistances) {
+        originDist = _mm_loadu_pd(originDistances + i);
+      } else {
+        originDist = _mm_add_pd(
+            _mm_add_pd(_mm_add_pd(_mm_mul_pd(a, ox), _mm_mul_pd(b, oy)),
+                       _mm_mul_pd(c, oz)),
+            _mm_loadu_pd(&f.d[i]));
+      }
+      __m128d denom = _mm_add_pd(
+          _mm_add_pd(_mm_mul_pd(a, dx), _mm_mul_pd(b, dy)), _mm_mul_pd(c, dz));
+      __m128d t = _mm_div_pd(_mm_xor_pd(originDist, signBit), denom);
+
+      // Raio paralelo ao plano: fora do semi-espaço, não há interseção
+      __m128d parallel =
+          _mm_and_pd(_mm_cmplt_pd(denom, eps), _mm_cmpgt_pd(denom, negEps));
+      outside = _mm_or_pd(
+          outside, _mm_and_pd(parallel, _mm_cmpgt_pd(originDist, zero)));
+
+      // Entrando (denom < 0) ou saindo (denom >= 0) do semi-espaço
+      __m128d entering = _mm_andnot_pd(
+          parallel,
+          _mm_and_pd(_mm_cmplt_pd(denom, zero), _mm_cmpgt_pd(t, nearT[v])));
+      __m128d exiting = _mm_andnot_pd(
+          parallel,
+          _mm_and_pd(_mm_cmpge_pd(denom, zero), _mm_cmplt_pd(t, farT[v])));
+      __m128d idx = _mm_set_pd(i + 1, i);
+      nearT[v] = selectLanes(entering, t, nearT[v]);
+      nearIdx[v] = selectLanes(entering, idx, nearIdx[v]);
+      farT[v] = selectLanes(exiting, t, farT[v]);
+      farIdx[v] = selectLanes(exiting, idx, farIdx[v]);
+    }
+
+    // Saída antecipada por bloco: face paralela por fora ou intervalo vazio
+    __m128d maxNear = nearT[0], minFar = farT[0];
+    for (int v = 1; v < POLY_VECTORS; v++) {
+      maxNear = _mm_max_pd(maxNear, nearT[v]);
+      minFar = _mm_min_pd(minFar, farT[v]);
+    }
+    maxNear = _mm_max_sd(maxNear, _mm_unpackhi_pd(maxNear, maxNear));
+    minFar = _mm_min_sd(minFar, _mm_unpackhi_pd(minFar, minFar));
+    if (_mm_movemask_pd(outside) || _mm_comigt_sd(maxNear, minFar))
+      return false;
+  }
+
+  // Redução entre lanes; empates ficam com a face de menor índice
+  tNear = -inf;
+  tFar = inf;
+  nearFace = farFace = -1;
+  for (int v = 0; v < POLY_VECTORS; v++) {
+    double nt[2], ft[2], ni[2], fi[2];
+    _mm_storeu_pd(nt, nearT[v]);
+    _mm_storeu_pd(ft, farT[v]);
+    _mm_storeu_pd(ni, nearIdx[v]);
+    _mm_storeu_pd(fi, farIdx[v]);
+    for (int k = 0; k < 2; k++) {
+      if (nt[k] > tNear || (nt[k] == tNear && ni[k] >= 0 && ni[k] < nearFace)) {
+        tNear = nt[k];
+        nearFace = (int)ni[k];
+      }
+      if (ft[k] < tFar || (ft[k] == tFar && fi[k] >= 0 && fi[k] < farFace)) {
+        tFar = ft[k];
+        farFace = (int)fi[k];
+      }
+    }
+  }
+  return true;
+}
+#else
+// Recorta o raio pelos semi-espaços do poliedro, uma face por vez.
+// originDistances (opcional) traz as distâncias da origem a cada face.
+// Retorna false se o raio não cruza o poliedro; senão devolve o intervalo
+// [tNear, tFar] e as faces de cada ponta.
+bool clipPolyhedron(const Ray &ray, const Object &poly,
+                    const double *originDistances, double &tNear,
+                    int &nearFace, double &tFar, int &farFace) {
+  const FaceArrays &f = poly.faceArrays;
+  tNear = -std::numeric_limits<double>::infinity();
+  tFar = std::numeric_limits<double>::infinity();
+  nearFace = farFace = -1;
+
+  for (size_t i = 0; i < f.a.size(); i++) {
+    double originDist = originDistances
+                            ? originDistances[i]
+                            : f.a[i] * ray.origin.x + f.b[i] * ray.origin.y +
+                                  f.c[i] * ray.origin.z + f.d[i];
+    double denom = f.a[i] * ray.direction.x + f.b[i] * ray.direction.y +
+                   f.c[i] * ray.direction.z;
+    double dist = -originDist / denom;
 
     if (fabs(denom) < 1e-10) {
       // Raio paralelo ao plano
-      if (plane.distance(ray.origin) > 0)
+      if (originDist > 0)
         return false;
       continue;
     }
-
     if (denom < 0) {
       // Entrando no semi-espaço
       if (dist > tNear) {
         tNear = dist;
-        nearNormal = n;
+        nearFace = (int)i;
       }
-    } else {
+    } else if (dist < tFar) {
       // Saindo do semi-espaço
-      if (dist < tFar) {
-        tFar = dist;
-        farNormal = n * -1.0;
-      }
+      tFar = dist;
+      farFace = (int)i;
     }
-
     if (tNear > tFar)
       return false;
   }
+  return true;
+}
+#endif
 
-  if (tNear < 0.001) {
-    tNear = tFar;
-    nearNormal = farNormal;
-  }
+// Checa se o raio intersecta o poliedro (originDistances: distâncias da
+// origem às faces, opcional)
+bool intersectPolyhedron(const Ray &ray, const Object &poly,
+                         HitCandidate &hit,
+                         const double *originDistances = nullptr) {
+  if (missesPolyhedronBounds(ray, poly))
+    return false;
 
-  if (tNear < 0.001 || tNear > 1e10)
+  double tNear, tFar;
+  int nearFace, farFace;
+  if (!clipPolyhedron(ray, poly, originDistances, tNear, nearFace, tFar,
+                      farFace))
     return false;
 
-  hit.hit = true;
-  hit.t = tNear;
-  hit.point = ray.at(tNear);
-  hit.normal = nearNormal.normalize();
+  // Saindo do poliedro: a normal da face é invertida
+  hit = HitCandidate(tNear, &poly, nearFace);
+  if (tNear < 0.001)
+    hit = HitCandidate(tFar, &poly, farFace, true);
+
+  if (hit.t < 0.001 || hit.t > 1e10)
+    return false;
 
   return true;
 }
 
-// Checa se o raio intersecta uma superfície quádrica
-bool intersectQuadric(const Ray &ray, const Object &quad, HitInfo &hit) {
-  // Raio: P(t) = O + tD
-  // Quádrica: Ax^2 + By^2 + Cz^2 + Dxy + Exz + Fyz + Gx + Hy + Iz + J = 0
-
-  // Substituindo P(t) na equação, obtemos: at^2 + bt + c = 0
-
+// Coeficientes de at^2 + bt + c = 0 obtidos substituindo o raio
+// P(t) = O + tD na quádrica
+// Ax^2 + By^2 + Cz^2 + Dxy + Exz + Fyz + Gx + Hy + Iz + J = 0
+void quadricCoefficients(const Ray &ray, const Object &quad, double &aq,
+                         double &bq, double &cq) {
   Vec3 o = ray.origin;
   Vec3 d = ray.direction;
 
   // Coeficiente de t^2
-  double aq = quad.A * d.x * d.x + quad.B * d.y * d.y + quad.C * d.z * d.z +
-              quad.D * d.x * d.y + quad.E * d.x * d.z + quad.F * d.y * d.z;
+  aq = quad.A * d.x * d.x + quad.B * d.y * d.y + quad.C * d.z * d.z +
+       quad.D * d.x * d.y + quad.E * d.x * d.z + quad.F * d.y * d.z;
 
   // Coeficiente de t
-  double bq = 2.0 * quad.A * o.x * d.x + 2.0 * quad.B * o.y * d.y +
-              2.0 * quad.C * o.z * d.z + quad.D * (o.x * d.y + o.y * d.x) +
-              quad.E * (o.x * d.z + o.z * d.x) +
-              quad.F * (o.y * d.z + o.z * d.y) + quad.G * d.x + quad.H * d.y +
-              quad.I * d.z;
+  bq = 2.0 * quad.A * o.x * d.x + 2.0 * quad.B * o.y * d.y +
+       2.0 * quad.C * o.z * d.z + quad.D * (o.x * d.y + o.y * d.x) +
+       quad.E * (o.x * d.z + o.z * d.x) + quad.F * (o.y * d.z + o.z * d.y) +
+       quad.G * d.x + quad.H * d.y + quad.I * d.z;
 
   // Termo constante
-  double cq = quad.A * o.x * o.x + quad.B * o.y * o.y + quad.C * o.z * o.z +
-              quad.D * o.x * o.y + quad.E * o.x * o.z + quad.F * o.y * o.z +
-              quad.G * o.x + quad.H * o.y + quad.I * o.z + quad.J;
+  cq = quad.A * o.x * o.x + quad.B * o.y * o.y + quad.C * o.z * o.z +
+       quad.D * o.x * o.y + quad.E * o.x * o.z + quad.F * o.y * o.z +
+       quad.G * o.x + quad.H * o.y + quad.I * o.z + quad.J;
+}
+
+// Gradiente da quádrica no ponto p
+Vec3 quadricGradient(const Object &quad, const Vec3 &p) {
+  return Vec3(2.0 * quad.A * p.x + quad.D * p.y + quad.E * p.z + quad.G,
+              2.0 * quad.B * p.y + quad.D * p.x + quad.F * p.z + quad.H,
+              2.0 * quad.C * p.z + quad.E * p.x + quad.F * p.y + quad.I);
+}
+
+// Checa se o raio intersecta uma superfície quádrica (terms: termos da
+// origem, opcional)
+bool intersectQuadric(const Ray &ray, const Object &quad, HitCandidate &hit,
+                      const OriginTerms *terms = nullptr) {
+  double aq, bq, cq;
+  if (terms) {
+    // O coeficiente de t é a derivada na origem ao longo da direção
+    const Vec3 &d = ray.direction;
+    aq = quad.A * d.x * d.x + quad.B * d.y * d.y + quad.C * d.z * d.z +
+         quad.D * d.x * d.y + quad.E * d.x * d.z + quad.F * d.y * d.z;
+    bq = terms->oc.dot(d);
+    cq = terms->c;
+  } else {
+    quadricCoefficients(ray, quad, aq, bq, cq);
+  }
 
   // Resolve equação quadrática
   double discriminant = bq * bq - 4.0 * aq * cq;
@@ -124,31 +327,187 @@ bool intersectQuadric(const Ray &ray, const Object &quad, HitInfo &hit) {
   double t1 = (-bq - sqrt_disc) / (2.0 * aq);
   double t2 = (-bq + sqrt_disc) / (2.0 * aq);
 
+  // Raízes fora da caixa de recorte (infinita por padrão) são descartadas
   double t = t1;
-  if (t < 0.001)
+  if (t < 0.001 || !quad.clip.contains(ray.origin + ray.direction * t))
     t = t2;
-  if (t < 0.001)
+  if (t < 0.001 || !quad.clip.contains(ray.origin + ray.direction * t))
     return false;
 
-  hit.hit = true;
-  hit.t = t;
-  hit.point = ray.at(t);
+  hit = HitCandidate(t, &quad);
+  return true;
+}
+
+// Intervalo [t0, t1] do raio (qualquer sinal) dentro da caixa, com a face de
+// entrada e a de saída codificadas como 2 * eixo + (1 se a normal para fora
+// aponta no sentido positivo do eixo)
+bool clipInterval(const Ray &ray, const AABB &box, double &t0, int &face0,
+                  double &t1, int &face1) {
+  t0 = -std::numeric_limits<double>::infinity();
+  t1 = std::numeric_limits<double>::infinity();
+  face0 = face1 = -1;
+  for (int axis = 0; axis < 3; axis++) {
+    double o = axis == 0 ? ray.origin.x
+                         : (axis == 1 ? ray.origin.y : ray.origin.z);
+    double d = axis == 0 ? ray.direction.x
+                         : (axis == 1 ? ray.direction.y : ray.direction.z);
+    double lo = axis == 0 ? box.min.x : (axis == 1 ? box.min.y : box.min.z);
+    double hi = axis == 0 ? box.max.x : (axis == 1 ? box.max.y : box.max.z);
+    if (d == 0) {
+      // Paralelo ao eixo: dentro ou fora da fatia por inteiro
+      if (o < lo || o > hi)
+        return false;
+      continue;
+    }
+    double ta = (lo - o) / d, tb = (hi - o) / d;
+    int fa = 2 * axis, fb = 2 * axis + 1;
+    if (ta > tb) {
+      std::swap(ta, tb);
+      std::swap(fa, fb);
+    }
+    if (ta > t0) {
+      t0 = ta;
+      face0 = fa;
+    }
+    if (tb < t1) {
+      t1 = tb;
+      face1 = fb;
+    }
+  }
+  return t0 <= t1;
+}
+
+// Percorre a BVH visitando primeiro o filho mais próximo. test(i) testa o
+// índice i de uma folha e pode reduzir tMax (em geral, o t do candidato
+// mais próximo, lido a cada nó).
+template <typename Test>
+void traverseBVH(const BVH &bvh, const Ray &ray, const double &tMax,
+                 Test test) {
+  Vec3 invDir(1.0 / ray.direction.x, 1.0 / ray.direction.y,
+              1.0 / ray.direction.z);
+  int stack[BVH_STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0) {
+    int nodeIdx = stack[--top];
+    const BVHNode &node = bvh.nodes[nodeIdx];
+    double tEnter;
+    if (!node.bounds.intersect(ray.origin, invDir, tMax, tEnter))
+      continue;
+
+    if (node.count > 0) {
+      for (int j = node.first; j < node.first + node.count; j++)
+        test(bvh.objects[j]);
+      continue;
+    }
+
+    int left = nodeIdx + 1, right = node.first;
+    double tLeft, tRight;
+    bool hitLeft =
+        bvh.nodes[left].bounds.intersect(ray.origin, invDir, tMax, tLeft);
+    bool hitRight =
+        bvh.nodes[right].bounds.intersect(ray.origin, invDir, tMax, tRight);
+    if (hitLeft && hitRight) {
+      // Empilha o mais distante primeiro
+      if (tLeft < tRight)
+        std::swap(left, right);
+      stack[top++] = left;
+      stack[top++] = right;
+    } else if (hitLeft) {
+      stack[top++] = left;
+    } else if (hitRight) {
+      stack[top++] = right;
+    }
+  }
+}
+
+// Raio cisalhado do teste de triângulos estanque (Woop, Benthin e Wald
+// 2013): o eixo dominante da direção vira z e a direção vira (0, 0, 1).
+// Cada vértice é levado a esse espaço sempre pelas mesmas operações, então
+// os dois triângulos de uma aresta a avaliam com os mesmos valores e nenhum
+// raio passa entre eles. Como só o índice do eixo muda, a troca de eixos é
+// escrita como produtos escalares (os termos nulos não alteram o valor).
+struct TriangleRay {
+  Vec3 origin;
+  Vec3 shearX, shearY, shearZ;
+
+  explicit TriangleRay(const Ray &ray) : origin(ray.origin) {
+    const Vec3 &d = ray.direction;
+    if (fabs(d.z) >= fabs(d.x) && fabs(d.z) >= fabs(d.y)) {
+      shearX = Vec3(1, 0, -d.x / d.z);
+      shearY = Vec3(0, 1, -d.y / d.z);
+      shearZ = Vec3(0, 0, 1.0 / d.z);
+    } else if (fabs(d.x) >= fabs(d.y)) {
+      shearX = Vec3(-d.y / d.x, 1, 0);
+      shearY = Vec3(-d.z / d.x, 0, 1);
+      shearZ = Vec3(1.0 / d.x, 0, 0);
+    } else {
+      shearX = Vec3(0, -d.z / d.y, 1);
+      shearY = Vec3(1, -d.x / d.y, 0);
+      shearZ = Vec3(0, 1.0 / d.y, 0);
+    }
+  }
+};
+
+// Distância t (de qualquer sinal) até o triângulo tri da malha. Aceita as
+// duas orientações; raios sobre uma aresta atingem os dois triângulos.
+bool intersectTriangle(const TriangleRay &tr, const Mesh &mesh, int tri,
+                       double &t) {
+  const int *idx = &mesh.indices[3 * tri];
+  Vec3 a = mesh.vertices[idx[0]] - tr.origin;
+  Vec3 b = mesh.vertices[idx[1]] - tr.origin;
+  Vec3 c = mesh.vertices[idx[2]] - tr.origin;
+  double ax = a.dot(tr.shearX), ay = a.dot(tr.shearY);
+  double bx = b.dot(tr.shearX), by = b.dot(tr.shearY);
+  double cx = c.dot(tr.shearX), cy = c.dot(tr.shearY);
+
+  // Funções de aresta: todas com o mesmo sinal (ou nulas) dentro
+  double u = cx * by - cy * bx;
+  double v = ax * cy - ay * cx;
+  double w = bx * ay - by * ax;
+  if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+    return false;
+  double det = u + v + w;
+  if (det == 0)
+    return false;
+
+  t = (u * a.dot(tr.shearZ) + v * b.dot(tr.shearZ) + w * c.dot(tr.shearZ)) /
+      det;
+  return true;
+}
 
-  // Calcula normal usando o gradiente da superfície
-  Vec3 p = hit.point;
-  hit.normal = Vec3(2.0 * quad.A * p.x + quad.D * p.y + quad.E * p.z + quad.G,
-                    2.0 * quad.B * p.y + quad.D * p.x + quad.F * p.z + quad.H,
-                    2.0 * quad.C * p.z + quad.E * p.x + quad.F * p.y + quad.I)
-                   .normalize();
+// Checa se o raio intersecta a malha (triângulo mais próximo pela BVH). O
+// raio é levado para o espaço da malha; a translação não altera t.
+bool intersectMesh(const Ray &ray, const Object &obj, HitCandidate &hit) {
+  const Mesh &mesh = *obj.mesh;
+  if (mesh.bvh.nodes.empty())
+    return false;
+
+  Ray local(ray.origin - obj.meshOffset, ray.direction);
+  TriangleRay tr(local);
+  double closest = std::numeric_limits<double>::infinity();
+  int closestTri = -1;
+  traverseBVH(mesh.bvh, local, closest, [&](int tri) {
+    double t;
+    if (intersectTriangle(tr, mesh, tri, t) && t >= 0.001 && t < closest) {
+      closest = t;
+      closestTri = tri;
+    }
+  });
+  if (closestTri < 0)
+    return false;
 
+  hit = HitCandidate(closest, &obj, closestTri);
   return true;
 }
 
 struct CSGIntersection {
-  double t;
-  Vec3 normal;
+  HitCandidate hit;
   int childIdx;
-  bool operator<(const CSGIntersection &other) const { return t < other.t; }
+  bool operator<(const CSGIntersection &other) const {
+    return hit.t < other.hit.t;
+  }
 };
 
 void getAllIntersections(const Ray &ray, const Object &obj,
@@ -163,70 +522,65 @@ void getAllIntersections(const Ray &ray, const Object &obj,
       double sqrt_disc = sqrt(discriminant);
       double t1 = (-b - sqrt_disc) / (2.0 * a);
       double t2 = (-b + sqrt_disc) / (2.0 * a);
-      hits.push_back({t1, (ray.at(t1) - obj.center).normalize(), -1});
-      hits.push_back({t2, (ray.at(t2) - obj.center).normalize(), -1});
+      hits.push_back({HitCandidate(t1, &obj), -1});
+      hits.push_back({HitCandidate(t2, &obj), -1});
     }
   } else if (obj.type == POLYHEDRON) {
-    double tNear = -std::numeric_limits<double>::infinity();
-    double tFar = std::numeric_limits<double>::infinity();
-    Vec3 nearNormal, farNormal;
-    bool hit = true;
-    for (const Plane &plane : obj.faces) {
-      Vec3 n = plane.normal();
-      double denom = n.dot(ray.direction);
-      double dist = -plane.distance(ray.origin) / denom;
-      if (fabs(denom) < 1e-10) {
-        if (plane.distance(ray.origin) > 0) {
-          hit = false;
-          break;
-        }
-        continue;
-      }
-      if (denom < 0) {
-        if (dist > tNear) {
-          tNear = dist;
-          nearNormal = n;
-        }
-      } else {
-        if (dist < tFar) {
-          tFar = dist;
-          farNormal = n;
-        }
-      }
-    }
-    if (hit && tNear <= tFar) {
-      hits.push_back({tNear, nearNormal.normalize(), -1});
-      hits.push_back({tFar, farNormal.normalize(), -1});
+    double tNear, tFar;
+    int nearFace, farFace;
+    if (!missesPolyhedronBounds(ray, obj) &&
+        clipPolyhedron(ray, obj, nullptr, tNear, nearFace, tFar, farFace)) {
+      hits.push_back({HitCandidate(tNear, &obj, nearFace), -1});
+      hits.push_back({HitCandidate(tFar, &obj, farFace), -1});
     }
   } else if (obj.type == QUADRIC) {
-    Vec3 o = ray.origin;
-    Vec3 d = ray.direction;
-    double aq = obj.A * d.x * d.x + obj.B * d.y * d.y + obj.C * d.z * d.z +
-                obj.D * d.x * d.y + obj.E * d.x * d.z + obj.F * d.y * d.z;
-    double bq = 2.0 * obj.A * o.x * d.x + 2.0 * obj.B * o.y * d.y +
-                2.0 * obj.C * o.z * d.z + obj.D * (o.x * d.y + o.y * d.x) +
-                obj.E * (o.x * d.z + o.z * d.x) +
-                obj.F * (o.y * d.z + o.z * d.y) + obj.G * d.x + obj.H * d.y +
-                obj.I * d.z;
-    double cq = obj.A * o.x * o.x + obj.B * o.y * o.y + obj.C * o.z * o.z +
-                obj.D * o.x * o.y + obj.E * o.x * o.z + obj.F * o.y * o.z +
-                obj.G * o.x + obj.H * o.y + obj.I * o.z + obj.J;
+    double aq, bq, cq;
+    quadricCoefficients(ray, obj, aq, bq, cq);
     double discriminant = bq * bq - 4.0 * aq * cq;
 
     if (discriminant >= 0) {
       double sqrt_disc = sqrt(discriminant);
       double t1 = (-bq - sqrt_disc) / (2.0 * aq);
       double t2 = (-bq + sqrt_disc) / (2.0 * aq);
-      auto getNormal = [&](double t) {
-        Vec3 p = ray.at(t);
-        return Vec3(2.0 * obj.A * p.x + obj.D * p.y + obj.E * p.z + obj.G,
-                    2.0 * obj.B * p.y + obj.D * p.x + obj.F * p.z + obj.H,
-                    2.0 * obj.C * p.z + obj.E * p.x + obj.F * p.y + obj.I)
-            .normalize();
-      };
-      hits.push_back({t1, getNormal(t1), -1});
-      hits.push_back({t2, getNormal(t2), -1});
+      if (obj.clip.isInfinite()) {
+        hits.push_back({HitCandidate(t1, &obj), -1});
+        hits.push_back({HitCandidate(t2, &obj), -1});
+      } else {
+        // Sólido recortado: o trecho entre as raízes limitado à caixa, com
+        // as faces da caixa fechando o corte
+        double b0, b1;
+        int f0, f1;
+        if (clipInterval(ray, obj.clip, b0, f0, b1, f1)) {
+          HitCandidate in(std::min(t1, t2), &obj);
+          HitCandidate out(std::max(t1, t2), &obj);
+          if (b0 > in.t)
+            in = HitCandidate(b0, &obj, f0);
+          if (b1 < out.t)
+            out = HitCandidate(b1, &obj, f1);
+          if (in.t <= out.t) {
+            hits.push_back({in, -1});
+            hits.push_back({out, -1});
+          }
+        }
+      }
     }
+  } else if (obj.type == MESH) {
+    // Todos os cruzamentos da reta (a paridade define o interior de uma
+    // malha fechada): a origem recua até fora da caixa da malha
+    const Mesh &mesh = *obj.mesh;
+    if (mesh.bvh.nodes.empty())
+      return;
+    Vec3 origin = ray.origin - obj.meshOffset;
+    double back = (mesh.bounds.center() - origin).length() +
+                  (mesh.bounds.max - mesh.bounds.min).length();
+    Ray line(origin - ray.direction * back, ray.direction);
+    TriangleRay tr(line);
+    const double inf = std::numeric_limits<double>::infinity();
+    traverseBVH(mesh.bvh, line, inf, [&](int tri) {
+      double t;
+      if (intersectTriangle(tr, mesh, tri, t))
+        hits.push_back({HitCandidate(t - back, &obj, tri), -1});
+    });
   } else if (obj.type == CSG) {
     std::vector<CSGIntersection> allChildHits;
     for (size_t i = 0; i < obj.csgChildren.size(); ++i) {
@@ -255,9 +609,10 @@ void getAllIntersections(const Ray &ray, const Object &obj,
       }
       bool isInside = inPositive && !inNegative;
       if (isInside != wasInside) {
+        // A normal é invertida na finalização (superfície da diferença)
         CSGIntersection newHit = hit;
         if (obj.csgOperations[hit.childIdx] == CSG_DIFFERENCE) {
-          newHit.normal = hit.normal * -1.0;
+          newHit.hit.flip = !newHit.hit.flip;
         }
         hits.push_back(newHit);
         wasInside = isInside;
@@ -266,7 +621,7 @@ void getAllIntersections(const Ray &ray, const Object &obj,
   }
 }
 
-bool intersectCSG(const Ray &ray, const Object &csg, HitInfo &hit) {
+bool intersectCSG(const Ray &ray, const Object &csg, HitCandidate &hit) {
   std::vector<CSGIntersection> hits;
   getAllIntersections(ray, csg, hits);
 
@@ -274,44 +629,271 @@ bool intersectCSG(const Ray &ray, const Object &csg, HitInfo &hit) {
   bool found = false;
 
   for (const auto &h : hits) {
-    if (h.t > 0.001 && h.t < closestT) {
-      closestT = h.t;
-      hit.t = h.t;
-      hit.normal = h.normal;
-      hit.point = ray.at(h.t);
-      hit.hit = true;
+    if (h.hit.t > 0.001 && h.hit.t < closestT) {
+      closestT = h.hit.t;
+      hit = h.hit;
       found = true;
     }
   }
   return found;
 }
 
-// Encontra o hit mais próximo na cena
-HitInfo findClosestHit(const Ray &ray, const Scene &scene) {
-  HitInfo closestHit;
-  closestHit.t = std::numeric_limits<double>::infinity();
+// Checa a interseção com um objeto de qualquer tipo (apenas a distância)
+bool intersectObject(const Ray &ray, const Object &obj, HitCandidate &hit) {
+  if (obj.type == SPHERE) {
+    return intersectSphere(ray, obj, hit);
+  } else if (obj.type == POLYHEDRON) {
+    return intersectPolyhedron(ray, obj, hit);
+  } else if (obj.type == QUADRIC) {
+    return intersectQuadric(ray, obj, hit);
+  } else if (obj.type == CSG) {
+    return intersectCSG(ray, obj, hit);
+  } else if (obj.type == MESH) {
+    return intersectMesh(ray, obj, hit);
+  }
+  return false;
+}
+
+// Checa se o raio intersecta uma instância: o raio é levado para o espaço
+// do protótipo e a distância volta para o espaço do mundo
+bool intersectInstance(const Ray &ray, const Instance &inst,
+                       const Scene &scene, HitCandidate &hit) {
+  Vec3 localDir = inst.toLocal.applyVector(ray.direction);
+  double scale = localDir.length();
+  Ray localRay(inst.toLocal.applyPoint(ray.origin), localDir);
+
+  const Object &proto = scene.prototypes[inst.prototypeIdx];
+  if (!intersectObject(localRay, proto, hit))
+    return false;
+
+  // Distância no espaço local é escalada pelo comprimento da direção
+  hit.t /= scale;
+  hit.instance = &inst;
+  return true;
+}
+
+// Checa a interseção com o objeto ou instância de índice i da cena
+bool intersectSceneItem(const Ray &ray, const Scene &scene, int i,
+                        HitCandidate &hit) {
+  int objects = (int)scene.objects.size();
+  if (i < objects)
+    return intersectObject(ray, scene.objects[i], hit);
+  return intersectInstance(ray, scene.instances[i - objects], scene, hit);
+}
+
+// Calcula os termos de origem de todos os objetos da cena
+void buildOriginCache(const Scene &scene, const Vec3 &origin,
+                      OriginCache &cache) {
+  cache.origin = origin;
+  cache.objects.assign(scene.objects.size(), OriginTerms());
+  cache.faceDistances.clear();
 
   for (size_t i = 0; i < scene.objects.size(); i++) {
-    HitInfo hit;
-    bool intersected = false;
-
-    if (scene.objects[i].type == SPHERE) {
-      intersected = intersectSphere(ray, scene.objects[i], hit);
-    } else if (scene.objects[i].type == POLYHEDRON) {
-      intersected = intersectPolyhedron(ray, scene.objects[i], hit);
-    } else if (scene.objects[i].type == QUADRIC) {
-      intersected = intersectQuadric(ray, scene.objects[i], hit);
-    } else if (scene.objects[i].type == CSG) {
-      intersected = intersectCSG(ray, scene.objects[i], hit);
+    const Object &obj = scene.objects[i];
+    OriginTerms &terms = cache.objects[i];
+    terms.firstFace = (int)cache.faceDistances.size();
+    if (obj.type == SPHERE) {
+      terms.oc = origin - obj.center;
+      terms.c = terms.oc.dot(terms.oc) - obj.radius * obj.radius;
+    } else if (obj.type == POLYHEDRON) {
+      // Uma distância por lane, incluindo os planos neutros
+      const FaceArrays &f = obj.faceArrays;
+      for (size_t j = 0; j < f.a.size(); j++)
+        cache.faceDistances.push_back(f.a[j] * origin.x + f.b[j] * origin.y +
+                                      f.c[j] * origin.z + f.d[j]);
+    } else if (obj.type == QUADRIC) {
+      const Vec3 &o = origin;
+      terms.oc = quadricGradient(obj, o);
+      terms.c = obj.A * o.x * o.x + obj.B * o.y * o.y + obj.C * o.z * o.z +
+                obj.D * o.x * o.y + obj.E * o.x * o.z + obj.F * o.y * o.z +
+                obj.G * o.x + obj.H * o.y + obj.I * o.z + obj.J;
+    }
+  }
+}
+
+// Interseção com o objeto i para um raio que parte de cache.origin
+// (instâncias não têm termos pré-calculados)
+bool intersectFromOrigin(const Ray &ray, const Scene &scene,
+                         const OriginCache &cache, int i, HitCandidate &hit) {
+  if (i >= (int)scene.objects.size())
+    return intersectSceneItem(ray, scene, i, hit);
+  const Object &obj = scene.objects[i];
+  const OriginTerms &terms = cache.objects[i];
+  if (obj.type == SPHERE) {
+    return intersectSphere(ray, obj, hit, &terms);
+  } else if (obj.type == POLYHEDRON) {
+    return intersectPolyhedron(ray, obj, hit,
+                               cache.faceDistances.data() + terms.firstFace);
+  } else if (obj.type == QUADRIC) {
+    return intersectQuadric(ray, obj, hit, &terms);
+  }
+  return intersectObject(ray, obj, hit);
+}
+
+// Normal do triângulo tri no ponto p: a dos vértices interpolada pelas
+// coordenadas baricêntricas, se o OBJ tem normais, senão a da face (regra
+// da mão direita na ordem dos vértices)
+Vec3 meshNormal(const Mesh &mesh, int tri, const Vec3 &p) {
+  const int *idx = &mesh.indices[3 * tri];
+  const Vec3 &v0 = mesh.vertices[idx[0]];
+  Vec3 e1 = mesh.vertices[idx[1]] - v0;
+  Vec3 e2 = mesh.vertices[idx[2]] - v0;
+  Vec3 face = e1.cross(e2);
+  if (mesh.normalIdx.empty())
+    return face;
+
+  Vec3 vp = p - v0;
+  double d00 = e1.dot(e1), d01 = e1.dot(e2), d11 = e2.dot(e2);
+  double d20 = vp.dot(e1), d21 = vp.dot(e2);
+  double denom = d00 * d11 - d01 * d01;
+  if (denom == 0)
+    return face;
+  double b1 = (d11 * d20 - d01 * d21) / denom;
+  double b2 = (d00 * d21 - d01 * d20) / denom;
+  const int *n = &mesh.normalIdx[3 * tri];
+  Vec3 normal = mesh.normals[n[0]] * (1.0 - b1 - b2) +
+                mesh.normals[n[1]] * b1 + mesh.normals[n[2]] * b2;
+  return normal.dot(normal) > 0 ? normal : face;
+}
+
+// Normal (não normalizada) da primitiva no ponto p
+Vec3 surfaceNormal(const Object &surface, const Vec3 &p, int face) {
+  if (surface.type == SPHERE)
+    return p - surface.center;
+
+  if (surface.type == POLYHEDRON)
+    return surface.faces[face].normal();
+
+  if (surface.type == MESH)
+    return meshNormal(*surface.mesh, face, p - surface.meshOffset);
+
+  // Quádrica: gradiente da superfície, ou face da caixa de recorte (CSG)
+  if (face >= 0) {
+    double sign = (face & 1) ? 1.0 : -1.0;
+    return Vec3(face / 2 == 0 ? sign : 0, face / 2 == 1 ? sign : 0,
+                face / 2 == 2 ? sign : 0);
+  }
+  return quadricGradient(surface, p);
+}
+
+// Segunda fase: calcula ponto e normal do candidato escolhido
+void finalizeHit(const Ray &ray, const HitCandidate &candidate,
+                 HitInfo &hit) {
+  hit.hit = true;
+  hit.t = candidate.t;
+  hit.point = ray.at(candidate.t);
+
+  const Instance *inst = candidate.instance;
+  Vec3 p = inst ? inst->toLocal.applyPoint(hit.point) : hit.point;
+  Vec3 normal = surfaceNormal(*candidate.surface, p, candidate.face);
+  if (candidate.flip)
+    normal = normal * -1.0;
+  if (inst)
+    normal = inst->toLocal.applyTransposed(normal);
+  hit.normal = normal.normalize();
+}
+
+// Primeira fase da busca: candidato mais próximo entre os objetos da BVH
+// dada, sem calcular ponto nem normal (raios de sombra param aqui). Se
+// origin não for nulo, o raio parte de origin->origin e usa seus termos.
+bool findClosestCandidate(const Ray &ray, const Scene &scene, const BVH &bvh,
+                          HitCandidate &closest, int &objectIdx,
+                          const OriginCache *origin = nullptr) {
+  closest.t = std::numeric_limits<double>::infinity();
+  objectIdx = -1;
+
+  auto testObject = [&](int i) {
+    HitCandidate hit;
+    bool found = origin ? intersectFromOrigin(ray, scene, *origin, i, hit)
+                        : intersectSceneItem(ray, scene, i, hit);
+    if (found && hit.t < closest.t) {
+      closest = hit;
+      objectIdx = i;
     }
+  };
+
+  for (int i : bvh.unbounded)
+    testObject(i);
+
+  if (bvh.nodes.empty())
+    return objectIdx >= 0;
+
+  // Cenas pequenas cabem numa única folha: a caixa não poupa nenhum teste
+  if (bvh.nodes.size() == 1) {
+    for (int i : bvh.objects)
+      testObject(i);
+    return objectIdx >= 0;
+  }
+
+  traverseBVH(bvh, ray, closest.t, testObject);
+  return objectIdx >= 0;
+}
 
-    if (intersected && hit.t < closestHit.t) {
-      closestHit = hit;
-      closestHit.objectIdx = i;
+// Busca de oclusores para raios de sombra: só candidatos antes de tMax (a
+// distância até a luz) contam. Com closest = false a busca para no primeiro
+// encontrado; com closest = true devolve o mais próximo deles.
+bool findOccluder(const Ray &ray, const Scene &scene, const BVH &bvh,
+                  double tMax, bool closest, HitCandidate &occluder) {
+  double limit = tMax;
+  bool found = false;
+  auto testObject = [&](int i) {
+    if (found && !closest)
+      return;
+    HitCandidate hit;
+    if (intersectSceneItem(ray, scene, i, hit) && hit.t < limit) {
+      occluder = hit;
+      found = true;
+      // Um limite negativo faz a travessia descartar os nós restantes
+      limit = closest ? hit.t : -1.0;
     }
+  };
+
+  for (int i : bvh.unbounded)
+    testObject(i);
+  if (bvh.nodes.size() == 1) {
+    for (int i : bvh.objects)
+      testObject(i);
+  } else if (!bvh.nodes.empty() && limit > 0) {
+    traverseBVH(bvh, ray, limit, testObject);
   }
+  return found;
+}
 
-  return closestHit;
+// Candidato mais próximo na cena
+bool findClosestCandidate(const Ray &ray, const Scene &scene,
+                          HitCandidate &closest, int &objectIdx,
+                          const OriginCache *origin = nullptr) {
+  const BVH &bvh = scene.bvh;
+  if (!bvh.nodes.empty() || !bvh.unbounded.empty())
+    return findClosestCandidate(ray, scene, bvh, closest, objectIdx, origin);
+
+  // BVH não construída: testa todos os objetos
+  closest.t = std::numeric_limits<double>::infinity();
+  objectIdx = -1;
+  for (int i = 0; i < sceneItemCount(scene); i++) {
+    HitCandidate hit;
+    bool found = origin ? intersectFromOrigin(ray, scene, *origin, i, hit)
+                        : intersectSceneItem(ray, scene, i, hit);
+    if (found && hit.t < closest.t) {
+      closest = hit;
+      objectIdx = i;
+    }
+  }
+  return objectIdx >= 0;
+}
+
+// Encontra o hit mais próximo na cena (as duas fases). origin pode ser
+// passado para raios que partem da origem do cache (raios primários).
+HitInfo findClosestHit(const Ray &ray, const Scene &scene,
+                       const OriginCache *origin = nullptr) {
+  HitInfo hit;
+  HitCandidate candidate;
+  int objectIdx;
+  if (findClosestCandidate(ray, scene, candidate, objectIdx, origin)) {
+    finalizeHit(ray, candidate, hit);
+    hit.objectIdx = objectIdx;
+  }
+  return hit;
 }
 
 #endif
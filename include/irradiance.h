@@ -0,0 +1,175 @@
+#ifndef IRRADIANCE_H
+#define IRRADIANCE_H
+
+#include "bvh.h"
+#include "structures.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Cache de irradiância: registros com a visibilidade de cada luz num ponto,
+// medida com vários raios de sombra, reaproveitada pelos hits difusos
+// próximos (a parte sem sombra do Phong continua exata em cada hit). Os
+// registros são criados antes da renderização (ver buildIrradianceCache) e
+// só lidos durante ela: as consultas dispensam travas e a imagem não depende
+// da ordem das threads.
+const int IRRADIANCE_MAX_LIGHTS = 16;       // Mais luzes: cache desligado
+const int IRRADIANCE_SHADOW_SAMPLES = 16;   // Raios de sombra por luz
+const int IRRADIANCE_STRIDE = 8;            // Espaçamento inicial (pixels)
+const int IRRADIANCE_MIN_STRIDE = 2;        // Espaçamento do último nível
+const double IRRADIANCE_RADIUS_SCALE = 1.5; // Raio de validade / espaçamento
+const double IRRADIANCE_MAX_STRETCH = 8.0;  // Alongamento rasante máximo
+const double IRRADIANCE_OCCLUDER_SCALE = 0.5; // Limite do raio / oclusor
+const double IRRADIANCE_NORMAL_ERROR = 0.3;   // Desvio de normal tolerado
+const double IRRADIANCE_PLANE_ERROR = 0.25;   // Afastamento do plano / raio
+const double IRRADIANCE_TOLERANCE = 0.05; // Divergência aceita entre registros
+
+// Registro do cache: a visibilidade das luzes 1..lights fica em
+// IrradianceCache::visibility, a partir de index * lights
+struct IrradianceRecord {
+  Vec3 position;
+  Vec3 normal;
+  double radius; // Raio de validade
+  int objectIdx;
+};
+
+// Registros e uma BVH sobre as esferas de validade (folhas indexam records)
+struct IrradianceCache {
+  int lights; // Luzes pontuais da cena (sem a ambiente)
+  std::vector<IrradianceRecord> records;
+  std::vector<float> visibility;
+  BVH bvh;
+
+  IrradianceCache() : lights(0) {}
+};
+
+// Refaz a BVH após inserir registros
+void buildIrradianceBVH(IrradianceCache &cache) {
+  cache.bvh.nodes.clear();
+  cache.bvh.objects.clear();
+
+  std::vector<BVHBuildRef> refs(cache.records.size());
+  for (size_t i = 0; i < refs.size(); i++) {
+    const IrradianceRecord &record = cache.records[i];
+    Vec3 r(record.radius, record.radius, record.radius);
+    refs[i].box.expand(record.position - r);
+    refs[i].box.expand(record.position + r);
+    refs[i].centroid = record.position;
+    refs[i].index = (int)i;
+  }
+  buildBVHFromRefs(cache.bvh, refs);
+}
+
+// Chama fn(index, error) para cada registro do objeto objectIdx que cobre
+// p (normal n). O erro segue Ward: distância relativa ao raio mais o
+// desvio da normal; o registro cobre o ponto se o erro é menor que 1.
+template <typename Fn>
+void forEachIrradianceRecord(const IrradianceCache &cache, const Vec3 &p,
+                             const Vec3 &n, int objectIdx, Fn fn) {
+  if (cache.bvh.nodes.empty())
+    return;
+
+  int stack[BVH_STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    int nodeIdx = stack[--top];
+    const BVHNode &node = cache.bvh.nodes[nodeIdx];
+    if (!node.bounds.contains(p))
+      continue;
+    if (node.count == 0) {
+      stack[top++] = nodeIdx + 1;
+      stack[top++] = node.first;
+      continue;
+    }
+
+    for (int j = node.first; j < node.first + node.count; j++) {
+      int index = cache.bvh.objects[j];
+      const IrradianceRecord &record = cache.records[index];
+      if (record.objectIdx != objectIdx)
+        continue;
+      Vec3 d = p - record.position;
+      if (fabs(d.dot(record.normal)) > IRRADIANCE_PLANE_ERROR * record.radius)
+        continue;
+      double error =
+          d.length() / record.radius +
+          sqrt(std::max(0.0, 1.0 - n.dot(record.normal))) /
+              IRRADIANCE_NORMAL_ERROR;
+      if (error < 1.0)
+        fn(index, error);
+    }
+  }
+}
+
+// Visibilidade de cada luz em p, interpolada entre os registros que cobrem
+// o ponto com peso 1 - erro. Luzes em que os registros discordam (desvio
+// padrão ponderado acima da tolerância: borda da sombra daquela luz)
+// recebem -1 e devem ser avaliadas normalmente. Retorna o número de luzes
+// interpoladas, 0 se nenhum registro cobre o ponto.
+int lookupIrradiance(const IrradianceCache &cache, const Vec3 &p,
+                     const Vec3 &n, int objectIdx, float *visibility) {
+  double weightSum = 0.0;
+  double sum[IRRADIANCE_MAX_LIGHTS], sumSq[IRRADIANCE_MAX_LIGHTS];
+  for (int i = 0; i < cache.lights; i++)
+    sum[i] = sumSq[i] = 0.0;
+
+  forEachIrradianceRecord(cache, p, n, objectIdx, [&](int index,
+                                                      double error) {
+    double weight = 1.0 - error;
+    const float *v = &cache.visibility[(size_t)index * cache.lights];
+    for (int i = 0; i < cache.lights; i++) {
+      sum[i] += weight * v[i];
+      sumSq[i] += weight * v[i] * v[i];
+    }
+    weightSum += weight;
+  });
+
+  if (weightSum <= 0.0)
+    return 0;
+  int valid = 0;
+  for (int i = 0; i < cache.lights; i++) {
+    double mean = sum[i] / weightSum;
+    double variance = sumSq[i] / weightSum - mean * mean;
+    if (variance > IRRADIANCE_TOLERANCE * IRRADIANCE_TOLERANCE) {
+      visibility[i] = -1.0f;
+      continue;
+    }
+    visibility[i] = (float)mean;
+    valid++;
+  }
+  return valid;
+}
+
+// Encolhe os registros a partir de first que discordam de outros além da
+// tolerância, e esses outros, até a distância entre os dois: um deixa de
+// cobrir o ponto do outro, e o espaço entre eles, onde a sombra muda, é
+// refinado pelos níveis seguintes ou avaliado normalmente. Refaz a BVH.
+void clampIrradianceRecords(IrradianceCache &cache, size_t first) {
+  buildIrradianceBVH(cache);
+  for (size_t k = first; k < cache.records.size(); k++) {
+    const float *own = &cache.visibility[k * cache.lights];
+    std::vector<int> conflicts;
+    forEachIrradianceRecord(
+        cache, cache.records[k].position, cache.records[k].normal,
+        cache.records[k].objectIdx, [&](int index, double) {
+          const float *v = &cache.visibility[(size_t)index * cache.lights];
+          for (int i = 0; i < cache.lights; i++) {
+            if (fabs(v[i] - own[i]) > IRRADIANCE_TOLERANCE) {
+              conflicts.push_back(index);
+              break;
+            }
+          }
+        });
+
+    for (int index : conflicts) {
+      IrradianceRecord &other = cache.records[index];
+      IrradianceRecord &record = cache.records[k];
+      double limit = (other.position - record.position).length();
+      other.radius = std::min(other.radius, limit);
+      record.radius = std::min(record.radius, limit);
+    }
+  }
+  buildIrradianceBVH(cache);
+}
+
+#endif
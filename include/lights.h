@@ -0,0 +1,127 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include "structures.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+const double LIGHT_RADIUS = 0.5;     // Meia aresta do cubo das luzes de área
+const int DEFAULT_LIGHT_SAMPLES = 8; // Luzes amostradas por ponto
+
+// Luminância da cor de uma luz (energia relativa usada na amostragem)
+double lightIntensity(const Light &light) {
+  return 0.2126 * light.color.x + 0.7152 * light.color.y +
+         0.0722 * light.color.z;
+}
+
+// Constrói recursivamente o nó sobre lights[first, first + count),
+// dividindo pela mediana no eixo de maior extensão
+int buildLightNode(std::vector<LightNode> &tree,
+                   const std::vector<Light> &lights, std::vector<int> &order,
+                   int first, int count) {
+  int nodeIdx = (int)tree.size();
+  tree.push_back(LightNode());
+
+  LightNode node;
+  node.intensity = 0.0;
+  node.attenuation = lights[order[first]].attenuation;
+  node.light = -1;
+  node.right = -1;
+
+  Vec3 pad(LIGHT_RADIUS, LIGHT_RADIUS, LIGHT_RADIUS);
+  for (int i = first; i < first + count; i++) {
+    const Light &light = lights[order[i]];
+    node.bounds.expand(light.position - pad);
+    node.bounds.expand(light.position + pad);
+    node.intensity += lightIntensity(light);
+    node.attenuation.x = std::min(node.attenuation.x, light.attenuation.x);
+    node.attenuation.y = std::min(node.attenuation.y, light.attenuation.y);
+    node.attenuation.z = std::min(node.attenuation.z, light.attenuation.z);
+  }
+
+  if (count == 1) {
+    node.light = order[first];
+    tree[nodeIdx] = node;
+    return nodeIdx;
+  }
+
+  Vec3 extent = node.bounds.max - node.bounds.min;
+  int axis = 0;
+  if (extent.y > extent.x)
+    axis = 1;
+  if (extent.z > (axis == 0 ? extent.x : extent.y))
+    axis = 2;
+
+  auto coord = [&](int idx) {
+    const Vec3 &p = lights[idx].position;
+    return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+  };
+  int mid = first + count / 2;
+  std::nth_element(order.begin() + first, order.begin() + mid,
+                   order.begin() + first + count,
+                   [&](int a, int b) { return coord(a) < coord(b); });
+
+  buildLightNode(tree, lights, order, first, mid - first);
+  node.right = buildLightNode(tree, lights, order, mid, first + count - mid);
+  tree[nodeIdx] = node;
+  return nodeIdx;
+}
+
+// Constrói a hierarquia sobre as luzes pontuais (a luz 0 é a ambiente)
+void buildLightTree(Scene &scene) {
+  scene.lightTree.clear();
+  std::vector<int> order;
+  for (size_t i = 1; i < scene.lights.size(); i++)
+    if (lightIntensity(scene.lights[i]) > 0)
+      order.push_back((int)i);
+  if (!order.empty())
+    buildLightNode(scene.lightTree, scene.lights, order, 0,
+                   (int)order.size());
+}
+
+// Estimativa da contribuição de um nó no ponto: intensidade total atenuada
+// pela distância ao centro do nó (limitada ao raio do nó, pois o ponto pode
+// estar dentro do agrupamento)
+double lightNodeImportance(const LightNode &node, const Vec3 &point) {
+  Vec3 center = node.bounds.center();
+  double radius = (node.bounds.max - center).length();
+  double dist = std::max((center - point).length(), radius);
+  const Vec3 &att = node.attenuation;
+  double denominator = att.x + att.y * dist + att.z * dist * dist;
+  return node.intensity / std::max(denominator, 1e-6);
+}
+
+// Escolhe uma luz descendo a hierarquia com probabilidade proporcional à
+// importância de cada filho. u em [0, 1) é reaproveitado a cada nível.
+// Retorna o índice da luz (ou -1) e sua probabilidade em pdf.
+int sampleLightTree(const Scene &scene, const Vec3 &point, double u,
+                    double &pdf) {
+  pdf = 1.0;
+  if (scene.lightTree.empty())
+    return -1;
+
+  int nodeIdx = 0;
+  while (scene.lightTree[nodeIdx].light < 0) {
+    int left = nodeIdx + 1;
+    int right = scene.lightTree[nodeIdx].right;
+    double wLeft = lightNodeImportance(scene.lightTree[left], point);
+    double wRight = lightNodeImportance(scene.lightTree[right], point);
+    if (wLeft + wRight <= 0)
+      return -1;
+
+    double pLeft = wLeft / (wLeft + wRight);
+    if (u < pLeft) {
+      u = std::min(u / pLeft, 1.0 - 1e-12);
+      pdf *= pLeft;
+      nodeIdx = left;
+    } else {
+      u = std::min((u - pLeft) / (1.0 - pLeft), 1.0 - 1e-12);
+      pdf *= 1.0 - pLeft;
+      nodeIdx = right;
+    }
+  }
+  return scene.lightTree[nodeIdx].light;
+}
+
+#endif
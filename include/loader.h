@@ -1,13 +1,34 @@
 #ifndef LOADER_H
 #define LOADER_H
 
+#include "bvh.h"
+#include "cache.h"
+#include "lights.h"
+#include "material.h"
+#include "shadows.h"
 #include "structures.h"
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <sstream>
 
+// Texturas decodificadas, indexadas por caminho e data de modificação
+typedef LRUCache<std::string, std::shared_ptr<const Texture>> TextureCache;
+
+// Chave de cache que muda quando o arquivo é modificado
+std::string fileCacheKey(const std::string &filename) {
+  std::error_code ec;
+  auto mtime = std::filesystem::last_write_time(filename, ec);
+  if (ec)
+    return filename;
+  return filename + "@" + std::to_string(mtime.time_since_epoch().count());
+}
+
 // Carrega textura PPM
-bool loadPPM(const std::string &filename, Pigment &pigment) {
+bool loadPPM(const std::string &filename, Texture &texture) {
   std::ifstream file(filename, std::ios::binary);
   if (!file.is_open()) {
     std::cerr << "Erro: Não foi possível abrir o arquivo de textura "
@@ -38,27 +59,26 @@ bool loadPPM(const std::string &filename, Pigment &pigment) {
     file.unget();
 
   int maxval;
-  file >> pigment.textureWidth >> pigment.textureHeight >> maxval;
+  file >> texture.width >> texture.height >> maxval;
 
-  pigment.textureData.resize(pigment.textureWidth * pigment.textureHeight);
+  texture.data.resize(texture.width * texture.height);
 
   if (magic == "P3") {
     // ASCII
-    for (int i = 0; i < pigment.textureWidth * pigment.textureHeight; i++) {
+    for (int i = 0; i < texture.width * texture.height; i++) {
       int r, g, b;
       file >> r >> g >> b;
-      pigment.textureData[i] =
+      texture.data[i] =
           Vec3(r / (double)maxval, g / (double)maxval, b / (double)maxval);
     }
   } else {
     // Formato binário
     file.get(); // Pula newline
-    for (int i = 0; i < pigment.textureWidth * pigment.textureHeight; i++) {
+    for (int i = 0; i < texture.width * texture.height; i++) {
       unsigned char rgb[3];
       file.read((char *)rgb, 3);
-      pigment.textureData[i] =
-          Vec3(rgb[0] / (double)maxval, rgb[1] / (double)maxval,
-               rgb[2] / (double)maxval);
+      texture.data[i] = Vec3(rgb[0] / (double)maxval, rgb[1] / (double)maxval,
+                             rgb[2] / (double)maxval);
     }
   }
 
@@ -66,8 +86,138 @@ bool loadPPM(const std::string &filename, Pigment &pigment) {
   return true;
 }
 
-// Helper para ler objetos recursivamente (por exemplo, o CSG)
-bool parseObject(std::ifstream &file, Object &obj) {
+// Carrega textura, reaproveitando a versão decodificada do cache se houver
+std::shared_ptr<const Texture> loadTexture(const std::string &filename,
+                                           TextureCache *textures) {
+  std::string key = fileCacheKey(filename);
+  std::shared_ptr<const Texture> cached;
+  if (textures && textures->get(key, cached))
+    return cached;
+
+  auto texture = std::make_shared<Texture>();
+  texture->key = key;
+  if (!loadPPM(filename, *texture))
+    return nullptr;
+
+  if (textures)
+    textures->put(key, texture);
+  return texture;
+}
+
+// Malhas já lidas durante a carga de uma cena, por arquivo e data de
+// modificação (objetos que usam o mesmo OBJ compartilham a malha)
+typedef std::map<std::string, std::shared_ptr<const Mesh>> MeshLibrary;
+
+// Lê um índice de vértice ou normal do OBJ (base 1, negativo conta do fim)
+// e o converte para base 0; devolve -1 se estiver fora do intervalo
+int objIndex(const char *&p, size_t count) {
+  char *end;
+  long index = strtol(p, &end, 10);
+  if (end == p)
+    return -1;
+  p = end;
+  if (index < 0)
+    index += (long)count;
+  else
+    index -= 1;
+  return (index >= 0 && index < (long)count) ? (int)index : -1;
+}
+
+// Carrega uma malha OBJ: vértices (v), normais (vn) e faces (f) com
+// índices v, v/vt, v//vn ou v/vt/vn; polígonos viram leques de triângulos.
+// As demais linhas (texturas, grupos, materiais) são ignoradas. As normais
+// só são usadas se todas as faces as indicarem.
+bool loadOBJ(const std::string &filename, Mesh &mesh) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Erro: Não foi possível abrir a malha " << filename
+              << std::endl;
+    return false;
+  }
+
+  bool allNormals = true;
+  std::string line;
+  std::vector<int> corners, cornerNormals;
+  for (int lineNumber = 1; std::getline(file, line); lineNumber++) {
+    const char *p = line.c_str();
+    while (*p == ' ' || *p == '\t')
+      p++;
+    if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t' || p[1] == 'n')) {
+      bool normal = p[1] == 'n';
+      char *end;
+      p += normal ? 2 : 1;
+      double x = strtod(p, &end);
+      double y = strtod(end, &end);
+      double z = strtod(end, &end);
+      (normal ? mesh.normals : mesh.vertices).push_back(Vec3(x, y, z));
+    } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+      p++;
+      corners.clear();
+      cornerNormals.clear();
+      while (true) {
+        while (*p == ' ' || *p == '\t' || *p == '\r')
+          p++;
+        if (!*p)
+          break;
+        int v = objIndex(p, mesh.vertices.size()), n = -1;
+        if (*p == '/') {
+          p++;
+          if (*p != '/')
+            strtol(p, (char **)&p, 10); // Coordenada de textura, ignorada
+          if (*p == '/') {
+            p++;
+            n = objIndex(p, mesh.normals.size());
+          }
+        }
+        if (v < 0 || (*p && *p != ' ' && *p != '\t' && *p != '\r')) {
+          std::cerr << "Erro: Face inválida na linha " << lineNumber
+                    << " de " << filename << std::endl;
+          return false;
+        }
+        corners.push_back(v);
+        cornerNormals.push_back(n);
+        allNormals = allNormals && n >= 0;
+      }
+      for (size_t k = 2; k < corners.size(); k++) {
+        size_t fan[3] = {0, k - 1, k};
+        for (size_t c : fan) {
+          mesh.indices.push_back(corners[c]);
+          mesh.normalIdx.push_back(cornerNormals[c]);
+        }
+      }
+    }
+  }
+
+  if (!allNormals) {
+    mesh.normals.clear();
+    mesh.normalIdx.clear();
+  }
+  buildMeshBVH(mesh);
+  return true;
+}
+
+// Malha do arquivo, lida uma única vez por carga de cena
+std::shared_ptr<const Mesh> loadMesh(const std::string &filename,
+                                     MeshLibrary &meshes) {
+  std::string key = fileCacheKey(filename);
+  auto found = meshes.find(key);
+  if (found != meshes.end())
+    return found->second;
+
+  auto mesh = std::make_shared<Mesh>();
+  mesh->path = filename;
+  mesh->key = key;
+  if (!loadOBJ(filename, *mesh))
+    return nullptr;
+  meshes[key] = mesh;
+  return mesh;
+}
+
+// Helper para ler objetos recursivamente (por exemplo, o CSG). Uma
+// instância só é aceita se instance não for nulo: ela é lida em *instance e
+// obj fica com o tipo INSTANCE.
+bool parseObject(std::istream &file, Object &obj, MeshLibrary &meshes,
+                 Instance *instance = nullptr) {
   file >> obj.pigmentIdx >> obj.finishIdx;
 
   std::string objType;
@@ -85,11 +235,31 @@ bool parseObject(std::ifstream &file, Object &obj) {
       file >> a >> b >> c >> d;
       obj.faces.push_back(Plane(a, b, c, d));
     }
+    obj.faceArrays.assign(obj.faces);
   } else if (objType == "quadric") {
     obj.type = QUADRIC;
     file >> obj.A >> obj.B >> obj.C;
     file >> obj.D >> obj.E >> obj.F;
     file >> obj.G >> obj.H >> obj.I >> obj.J;
+
+    // Caixa de recorte opcional: clip xmin ymin zmin xmax ymax zmax
+    if ((file >> std::ws).peek() == 'c') {
+      std::string keyword;
+      file >> keyword;
+      if (keyword != "clip") {
+        std::cerr << "Erro: Esperado clip após a quádrica, encontrado "
+                  << keyword << std::endl;
+        return false;
+      }
+      AABB &clip = obj.clip;
+      file >> clip.min.x >> clip.min.y >> clip.min.z;
+      file >> clip.max.x >> clip.max.y >> clip.max.z;
+      if (clip.min.x > clip.max.x || clip.min.y > clip.max.y ||
+          clip.min.z > clip.max.z) {
+        std::cerr << "Erro: Caixa de recorte inválida" << std::endl;
+        return false;
+      }
+    }
   } else if (objType == "csg") {
     obj.type = CSG;
     int numChildren;
@@ -103,22 +273,45 @@ bool parseObject(std::ifstream &file, Object &obj) {
         obj.csgOperations.push_back(CSG_DIFFERENCE);
 
       Object child;
-      parseObject(file, child);
+      if (!parseObject(file, child, meshes))
+        return false;
       obj.csgChildren.push_back(child);
     }
+  } else if (objType == "mesh") {
+    obj.type = MESH;
+    std::string path;
+    file >> path;
+    obj.mesh = loadMesh(path, meshes);
+    if (!obj.mesh)
+      return false;
+  } else if (objType == "instance") {
+    // instance <protótipo> tx ty tz rx ry rz sx sy sz (rotações em graus)
+    if (!instance) {
+      std::cerr << "Erro: Instâncias só podem aparecer na lista de objetos"
+                << std::endl;
+      return false;
+    }
+    obj.type = INSTANCE;
+    Vec3 t, r, s;
+    file >> instance->prototypeIdx;
+    file >> t.x >> t.y >> t.z >> r.x >> r.y >> r.z >> s.x >> s.y >> s.z;
+    if (s.x == 0 || s.y == 0 || s.z == 0) {
+      std::cerr << "Erro: Escala nula na instância" << std::endl;
+      return false;
+    }
+    instance->pigmentIdx = obj.pigmentIdx;
+    instance->finishIdx = obj.finishIdx;
+    instance->toWorld = Transform::translate(t) * Transform::rotate(2, r.z) *
+                        Transform::rotate(1, r.y) *
+                        Transform::rotate(0, r.x) * Transform::scale(s);
+    instance->toLocal = instance->toWorld.inverse();
   }
   return true;
 }
 
-// Carrega cena do arquivo
-bool loadScene(const std::string &filename, Scene &scene) {
-  std::ifstream file(filename);
-  if (!file.is_open()) {
-    std::cerr << "Erro: Não foi possível abrir o arquivo de cena " << filename
-              << std::endl;
-    return false;
-  }
-
+// Lê a cena de um fluxo já aberto (texturas opcionalmente via cache)
+bool loadScene(std::istream &file, Scene &scene,
+               TextureCache *textures = nullptr) {
   // 1 - Configuração da câmera
   file >> scene.eye.x >> scene.eye.y >> scene.eye.z;
   file >> scene.lookAt.x >> scene.lookAt.y >> scene.lookAt.z;
@@ -159,7 +352,8 @@ bool loadScene(const std::string &filename, Scene &scene) {
       file >> pig.p1[0] >> pig.p1[1] >> pig.p1[2] >> pig.p1[3];
 
       // Carrega textura
-      if (!loadPPM(pig.texturePath, pig)) {
+      pig.texture = loadTexture(pig.texturePath, textures);
+      if (!pig.texture) {
         std::cerr << "Warning: Could not load texture " << pig.texturePath
                   << std::endl;
       }
@@ -178,17 +372,79 @@ bool loadScene(const std::string &filename, Scene &scene) {
     scene.finishes.push_back(finish);
   }
 
-  // 5 - Objetos
-  int numObjects;
-  file >> numObjects;
+  MeshLibrary meshes;
+
+  // 5 - Protótipos (opcional): geometria compartilhada pelas instâncias
+  std::string token;
+  file >> token;
+  if (token == "prototypes") {
+    int numPrototypes;
+    file >> numPrototypes;
+    for (int i = 0; i < numPrototypes; i++) {
+      Object proto;
+      if (!parseObject(file, proto, meshes))
+        return false;
+      scene.prototypes.push_back(proto);
+    }
+    file >> token;
+  }
+
+  // 6 - Objetos (instâncias vão para a lista própria)
+  int numObjects = atoi(token.c_str());
   for (int i = 0; i < numObjects; i++) {
     Object obj;
-    parseObject(file, obj);
-    scene.objects.push_back(obj);
+    Instance inst;
+    if (!parseObject(file, obj, meshes, &inst))
+      return false;
+
+    if (obj.type != INSTANCE) {
+      scene.objects.push_back(obj);
+      continue;
+    }
+    if (inst.prototypeIdx < 0 ||
+        inst.prototypeIdx >= (int)scene.prototypes.size()) {
+      std::cerr << "Erro: Protótipo inexistente " << inst.prototypeIdx
+                << std::endl;
+      return false;
+    }
+    // -1 herda o pigmento/acabamento do protótipo
+    const Object &proto = scene.prototypes[inst.prototypeIdx];
+    if (inst.pigmentIdx < 0)
+      inst.pigmentIdx = proto.pigmentIdx;
+    if (inst.finishIdx < 0)
+      inst.finishIdx = proto.finishIdx;
+    scene.instances.push_back(inst);
   }
 
-  file.close();
+  classifyMaterials(scene);
+  buildBVH(scene);
+  buildLightTree(scene);
+  buildShadowCasters(scene);
   return true;
 }
 
+// Lê o texto do arquivo de cena
+bool readSceneText(const std::string &filename, std::string &text) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Erro: Não foi possível abrir o arquivo de cena " << filename
+              << std::endl;
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  text = buffer.str();
+  return true;
+}
+
+// Carrega cena do arquivo (texturas opcionalmente via cache)
+bool loadScene(const std::string &filename, Scene &scene,
+               TextureCache *textures = nullptr) {
+  std::string text;
+  if (!readSceneText(filename, text))
+    return false;
+  std::istringstream stream(text);
+  return loadScene(stream, scene, textures);
+}
+
 #endif
@@ -0,0 +1,44 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include "structures.h"
+
+// Recursos de um acabamento que mudam o caminho do sombreamento
+const int MATERIAL_DIFFUSE = 1;  // kd > 0
+const int MATERIAL_SPECULAR = 2; // ks > 0 (exige pow)
+const int MATERIAL_REFLECT = 4;  // kr > 0 (raio refletido)
+const int MATERIAL_REFRACT = 8;  // kt > 0 (raio refratado)
+const int MATERIAL_FLAG_COUNT = 16;
+
+// Um núcleo por combinação de tipo de pigmento e recursos do acabamento
+const int SHADE_KERNEL_COUNT = 3 * MATERIAL_FLAG_COUNT;
+
+int materialFlags(const Finish &finish) {
+  int flags = 0;
+  if (finish.kd > 0)
+    flags |= MATERIAL_DIFFUSE;
+  if (finish.ks > 0)
+    flags |= MATERIAL_SPECULAR;
+  if (finish.kr > 0)
+    flags |= MATERIAL_REFLECT;
+  if (finish.kt > 0)
+    flags |= MATERIAL_REFRACT;
+  return flags;
+}
+
+// Índice do núcleo de sombreamento para o par pigmento/acabamento
+int materialKernel(const Pigment &pigment, const Finish &finish) {
+  return pigment.type * MATERIAL_FLAG_COUNT + materialFlags(finish);
+}
+
+// Classifica os materiais de todos os objetos e instâncias (feito uma vez,
+// ao carregar)
+void classifyMaterials(Scene &scene) {
+  for (int i = 0; i < sceneItemCount(scene); i++) {
+    SceneItem &item = sceneItem(scene, i);
+    item.material = materialKernel(scene.pigments[item.pigmentIdx],
+                                   scene.finishes[item.finishIdx]);
+  }
+}
+
+#endif
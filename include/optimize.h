@@ -0,0 +1,352 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "bounds.h"
+#include "bvh.h"
+#include "lights.h"
+#include "material.h"
+#include "shadows.h"
+#include "structures.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+// Passo de otimização entre a carga e a renderização: reescreve a geometria
+// em formas equivalentes mais baratas sem mudar a imagem. Cada regra só é
+// aplicada quando o resultado da interseção é o mesmo (mesmo t, mesma
+// normal) para todo raio que o renderizador pode traçar.
+
+// Folga usada nos testes de envolvimento: cobre o deslocamento dos raios de
+// sombra (até 0.01 ao longo da normal) com margem
+const double OPTIMIZE_MARGIN = 0.05;
+
+struct OptimizeOptions {
+  // Remover objetos exige índices estáveis apenas dentro da cena (as
+  // animações se referem aos objetos pelo índice)
+  bool removeUnreachable;
+  double lensRadius; // Raio da abertura: o olho ocupa o disco da lente
+
+  OptimizeOptions() : removeUnreachable(true), lensRadius(0.0) {}
+};
+
+// O que o passo alterou
+struct OptimizeReport {
+  int quadricsToSpheres;
+  int csgCollapsed;
+  int csgChildrenDropped;
+  int facesDropped;
+  int objectsRemoved;
+
+  OptimizeReport()
+      : quadricsToSpheres(0), csgCollapsed(0), csgChildrenDropped(0),
+        facesDropped(0), objectsRemoved(0) {}
+
+  bool changed() const {
+    return quadricsToSpheres || csgCollapsed || csgChildrenDropped ||
+           facesDropped || objectsRemoved;
+  }
+};
+
+// Quádrica Ax^2 + Ay^2 + Az^2 + Gx + Hy + Iz + J com A > 0 é uma esfera (com
+// A < 0 o gradiente aponta para dentro e a normal mudaria). A caixa de
+// recorte, se houver, precisa conter a esfera inteira.
+bool quadricAsSphere(Object &obj) {
+  if (obj.type != QUADRIC || !(obj.A > 0) || obj.B != obj.A ||
+      obj.C != obj.A || obj.D != 0 || obj.E != 0 || obj.F != 0)
+    return false;
+
+  Vec3 center(-obj.G / (2.0 * obj.A), -obj.H / (2.0 * obj.A),
+              -obj.I / (2.0 * obj.A));
+  double radius2 = center.dot(center) - obj.J / obj.A;
+  if (!(radius2 > 0))
+    return false;
+
+  double radius = sqrt(radius2);
+  Vec3 r(radius, radius, radius);
+  if (!obj.clip.isInfinite() &&
+      !(obj.clip.contains(center - r) && obj.clip.contains(center + r)))
+    return false;
+
+  obj.type = SPHERE;
+  obj.center = center;
+  obj.radius = radius;
+  return true;
+}
+
+// Remove planos repetidos e semi-espaços redundantes (que não tocam o
+// poliedro). Só para poliedros limitados: nos ilimitados os vértices no cubo
+// de recorte não são vértices de verdade. Um plano redundante nunca define a
+// entrada ou a saída de um raio que cruza o poliedro, e os que não cruzam
+// continuam sem cruzar.
+int dropRedundantFaces(Object &obj) {
+  if (obj.type != POLYHEDRON)
+    return 0;
+  // Poliedro vazio: sem vértices todos os planos pareceriam redundantes
+  AABB bounds = polyhedronBounds(obj.faces);
+  if (bounds.isEmpty() || bounds.isInfinite())
+    return 0;
+
+  std::vector<Plane> unique;
+  for (const Plane &plane : obj.faces) {
+    bool repeated = false;
+    for (const Plane &kept : unique)
+      repeated = repeated || (kept.a == plane.a && kept.b == plane.b &&
+                              kept.c == plane.c && kept.d == plane.d);
+    if (!repeated)
+      unique.push_back(plane);
+  }
+
+  std::vector<Vec3> vertices;
+  for (const auto &poly : polyhedronPolygons(unique))
+    vertices.insert(vertices.end(), poly.begin(), poly.end());
+  AABB box = polyhedronBounds(unique);
+  double tolerance = 1e-7 * (box.max - box.min).length() + 1e-9;
+
+  std::vector<Plane> kept;
+  for (const Plane &plane : unique) {
+    double farthest = -std::numeric_limits<double>::infinity();
+    for (const Vec3 &v : vertices)
+      farthest = std::max(farthest, plane.distance(v));
+    if (farthest > -tolerance)
+      kept.push_back(plane);
+  }
+
+  int dropped = (int)(obj.faces.size() - kept.size());
+  if (dropped > 0) {
+    obj.faces = kept;
+    obj.faceArrays.assign(obj.faces);
+  }
+  return dropped;
+}
+
+// Caixas sem interseção (uma delas vazia conta como disjunta)
+bool disjointBounds(const AABB &a, const AABB &b) {
+  if (a.isEmpty() || b.isEmpty())
+    return true;
+  return a.max.x < b.min.x || b.max.x < a.min.x || a.max.y < b.min.y ||
+         b.max.y < a.min.y || a.max.z < b.min.z || b.max.z < a.min.z;
+}
+
+// Simplifica um objeto e seus filhos de CSG. Filhos de diferença que não
+// tocam a parte positiva e filhos vazios são descartados; um CSG aninhado
+// com um único filho de união vira o próprio filho (as interseções são as
+// mesmas). O CSG do nível superior é tratado por collapseTopLevelCSG.
+void simplifyObject(Object &obj, const std::vector<Object> &prototypes,
+                    OptimizeReport &report) {
+  if (quadricAsSphere(obj))
+    report.quadricsToSpheres++;
+  report.facesDropped += dropRedundantFaces(obj);
+  if (obj.type != CSG)
+    return;
+
+  for (Object &child : obj.csgChildren) {
+    simplifyObject(child, prototypes, report);
+    if (child.type == CSG && child.csgChildren.size() == 1 &&
+        child.csgOperations[0] == CSG_UNION) {
+      Object inner = child.csgChildren[0];
+      child = inner;
+      report.csgCollapsed++;
+    }
+  }
+
+  computeBounds(obj, prototypes);
+  std::vector<Object> children;
+  std::vector<CSGOperation> operations;
+  for (size_t i = 0; i < obj.csgChildren.size(); i++) {
+    const Object &child = obj.csgChildren[i];
+    bool empty = child.bounds.isEmpty();
+    if (empty || (obj.csgOperations[i] == CSG_DIFFERENCE &&
+                  !obj.bounds.isInfinite() &&
+                  disjointBounds(child.bounds, obj.bounds))) {
+      report.csgChildrenDropped++;
+      continue;
+    }
+    children.push_back(child);
+    operations.push_back(obj.csgOperations[i]);
+  }
+  obj.csgChildren = children;
+  obj.csgOperations = operations;
+  computeBounds(obj, prototypes);
+}
+
+// Um CSG do nível superior com um único filho de união é trocado pelo filho
+// quando o teste isolado do filho dá o mesmo hit que o do CSG: esferas,
+// CSGs e elipsoides sem recorte sempre; poliedros só se nenhum raio parte de
+// dentro deles (opacos e sem o olho dentro), pois sozinhos eles invertem a
+// normal do hit de saída. Pigmento e acabamento continuam os do CSG.
+bool collapseTopLevelCSG(Object &obj, const Scene &scene, double lensRadius) {
+  if (obj.type != CSG || obj.csgChildren.size() != 1 ||
+      obj.csgOperations[0] != CSG_UNION)
+    return false;
+
+  const Object &child = obj.csgChildren[0];
+  bool sameHit = child.type == SPHERE || child.type == CSG;
+  if (child.type == QUADRIC)
+    sameHit = child.clip.isInfinite() && !quadricBounds(child).isInfinite();
+  if (child.type == POLYHEDRON)
+    sameHit = scene.finishes[obj.finishIdx].kt == 0 &&
+              convexClearance(child, scene.eye) < -lensRadius;
+  if (!sameHit)
+    return false;
+
+  Object collapsed = child;
+  collapsed.pigmentIdx = obj.pigmentIdx;
+  collapsed.finishIdx = obj.finishIdx;
+  collapsed.material = obj.material;
+  obj = collapsed;
+  return true;
+}
+
+// Folga entre a caixa e a borda de um objeto convexo: positiva se a caixa
+// inteira está dentro (inside = true) ou inteira fora (inside = false) com
+// essa distância. Para a esfera "fora" usa o ponto da caixa mais próximo do
+// centro; para o poliedro basta um plano que deixe os 8 cantos de fora.
+double boxClearance(const Object &convex, const AABB &box, bool inside) {
+  if (inside) {
+    double clearance = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < 8; i++) {
+      Vec3 corner(i & 1 ? box.max.x : box.min.x,
+                  i & 2 ? box.max.y : box.min.y,
+                  i & 4 ? box.max.z : box.min.z);
+      clearance = std::min(clearance, convexClearance(convex, corner));
+    }
+    return clearance;
+  }
+
+  if (convex.type == SPHERE) {
+    Vec3 c = convex.center;
+    Vec3 nearest(std::clamp(c.x, box.min.x, box.max.x),
+                 std::clamp(c.y, box.min.y, box.max.y),
+                 std::clamp(c.z, box.min.z, box.max.z));
+    return (nearest - c).length() - convex.radius;
+  }
+
+  double best = -std::numeric_limits<double>::infinity();
+  for (const Plane &plane : convex.faces) {
+    double nearest = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < 8; i++) {
+      Vec3 corner(i & 1 ? box.max.x : box.min.x,
+                  i & 2 ? box.max.y : box.min.y,
+                  i & 4 ? box.max.z : box.min.z);
+      nearest = std::min(nearest, plane.distance(corner));
+    }
+    best = std::max(best, nearest);
+  }
+  return best;
+}
+
+// Objetos que nenhum raio alcança. Um convexo opaco e sem reflexão (as
+// reflexões partem de fora da superfície) separa o espaço: se contém o olho
+// e todas as luzes, o que está inteiro fora dele nunca é visto nem faz
+// sombra; se não contém o olho nem luz alguma, o que está inteiro dentro
+// também não. Objetos vazios (caixa vazia) nunca são atingidos.
+std::vector<bool> unreachableObjects(const Scene &scene, double lensRadius) {
+  int count = sceneItemCount(scene);
+  std::vector<bool> unreachable(count, false);
+  const double lightReach = LIGHT_RADIUS * sqrt(3.0) + OPTIMIZE_MARGIN;
+
+  for (int i = 0; i < count; i++)
+    unreachable[i] = sceneItem(scene, i).bounds.isEmpty();
+
+  for (size_t j = 0; j < scene.objects.size(); j++) {
+    const Object &wall = scene.objects[j];
+    const Finish &finish = scene.finishes[wall.finishIdx];
+    if ((wall.type != SPHERE && wall.type != POLYHEDRON) || finish.kr > 0 ||
+        finish.kt > 0 || unreachable[j])
+      continue;
+
+    double eye = convexClearance(wall, scene.eye);
+    bool allLights = true, noLights = true;
+    for (const Light &light : scene.lights) {
+      double clearance = convexClearance(wall, light.position);
+      allLights = allLights && clearance > lightReach;
+      noLights = noLights && clearance < -lightReach;
+    }
+
+    bool keepsOutsideAway = eye > lensRadius + OPTIMIZE_MARGIN && allLights;
+    bool keepsInsideAway = eye < -(lensRadius + OPTIMIZE_MARGIN) && noLights;
+    if (!keepsOutsideAway && !keepsInsideAway)
+      continue;
+
+    for (int i = 0; i < count; i++) {
+      const AABB &box = sceneItem(scene, i).bounds;
+      if (i == (int)j || unreachable[i] || box.isInfinite())
+        continue;
+      if (boxClearance(wall, box, keepsInsideAway) > OPTIMIZE_MARGIN)
+        unreachable[i] = true;
+    }
+  }
+  return unreachable;
+}
+
+// Executa o passo de otimização e reconstrói as estruturas que dependem dos
+// objetos (materiais, BVH e oclusores por luz)
+OptimizeReport optimizeScene(Scene &scene,
+                             const OptimizeOptions &options = {}) {
+  OptimizeReport report;
+
+  for (Object &proto : scene.prototypes)
+    simplifyObject(proto, scene.prototypes, report);
+  for (Object &obj : scene.objects) {
+    simplifyObject(obj, scene.prototypes, report);
+    if (collapseTopLevelCSG(obj, scene, options.lensRadius))
+      report.csgCollapsed++;
+  }
+
+  if (options.removeUnreachable) {
+    for (Object &obj : scene.objects)
+      computeBounds(obj, scene.prototypes);
+    for (Instance &inst : scene.instances)
+      computeBounds(inst, scene.prototypes);
+    std::vector<bool> unreachable =
+        unreachableObjects(scene, options.lensRadius);
+    std::vector<Object> kept;
+    std::vector<Instance> keptInstances;
+    int objects = (int)scene.objects.size();
+    for (int i = 0; i < sceneItemCount(scene); i++) {
+      if (unreachable[i])
+        report.objectsRemoved++;
+      else if (i < objects)
+        kept.push_back(scene.objects[i]);
+      else
+        keptInstances.push_back(scene.instances[i - objects]);
+    }
+    scene.objects.swap(kept);
+    scene.instances.swap(keptInstances);
+  }
+
+  if (report.changed()) {
+    classifyMaterials(scene);
+    buildBVH(scene);
+    buildShadowCasters(scene);
+  }
+  return report;
+}
+
+// Resumo do que foi alterado
+void printOptimizeReport(const OptimizeReport &report, std::ostream &out) {
+  if (!report.changed()) {
+    out << "Otimização: nenhuma alteração" << std::endl;
+    return;
+  }
+  out << "Otimização:" << std::endl;
+  if (report.quadricsToSpheres)
+    out << "  Quádricas convertidas em esferas: " << report.quadricsToSpheres
+        << std::endl;
+  if (report.csgCollapsed)
+    out << "  CSGs de um só filho desfeitos: " << report.csgCollapsed
+        << std::endl;
+  if (report.csgChildrenDropped)
+    out << "  Filhos de CSG sem efeito removidos: "
+        << report.csgChildrenDropped << std::endl;
+  if (report.facesDropped)
+    out << "  Faces redundantes removidas: " << report.facesDropped
+        << std::endl;
+  if (report.objectsRemoved)
+    out << "  Objetos inalcançáveis removidos: " << report.objectsRemoved
+        << std::endl;
+}
+
+#endif
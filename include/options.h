@@ -0,0 +1,34 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+#include <vector>
+
+// Opções nomeadas da linha de comando, usadas pelo a.out e pelas
+// ferramentas de tools/ (podem aparecer em qualquer posição)
+
+// Remove a opção "--nome" dos argumentos, se presente
+bool takeFlag(std::vector<char *> &args, const std::string &name) {
+  for (size_t i = 1; i < args.size(); i++) {
+    if (name == args[i]) {
+      args.erase(args.begin() + i);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Remove a opção "--nome valor" dos argumentos, se presente
+bool takeOption(std::vector<char *> &args, const std::string &name,
+                std::string &value) {
+  for (size_t i = 1; i + 1 < args.size(); i++) {
+    if (name == args[i]) {
+      value = args[i + 1];
+      args.erase(args.begin() + i, args.begin() + i + 2);
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif
@@ -4,11 +4,12 @@
 #include "structures.h"
 #include <cmath>
 
-// Obtem cor do pigmento em um ponto
-Vec3 getPigmentColor(const Pigment &pigment, const Vec3 &point) {
-  if (pigment.type == SOLID) {
+// Cor do pigmento em um ponto, especializada pelo tipo de pigmento
+template <PigmentType Type>
+Vec3 pigmentColor(const Pigment &pigment, const Vec3 &point) {
+  if constexpr (Type == SOLID) {
     return pigment.color1;
-  } else if (pigment.type == CHECKER) {
+  } else if constexpr (Type == CHECKER) {
     // Padrão xadrez em 3D
     int xi = (int)floor(point.x / pigment.scale);
     int yi = (int)floor(point.y / pigment.scale);
@@ -16,7 +17,7 @@ Vec3 getPigmentColor(const Pigment &pigment, const Vec3 &point) {
 
     bool even = ((xi + yi + zi) % 2) == 0;
     return even ? pigment.color1 : pigment.color2;
-  } else if (pigment.type == TEXMAP) {
+  } else {
     // Mapeamento de textura usando as coordenadas homogêneas
     double px = point.x;
     double py = point.y;
@@ -35,24 +36,35 @@ Vec3 getPigmentColor(const Pigment &pigment, const Vec3 &point) {
     r = r - floor(r);
 
     // Busca a cor na textura
-    if (pigment.textureWidth > 0 && pigment.textureHeight > 0 &&
-        pigment.textureData.size() > 0) {
-      int u = (int)(s * pigment.textureWidth) % pigment.textureWidth;
-      int v = (int)(r * pigment.textureHeight) % pigment.textureHeight;
+    const Texture *tex = pigment.texture.get();
+    if (tex && tex->width > 0 && tex->height > 0 && tex->data.size() > 0) {
+      int u = (int)(s * tex->width) % tex->width;
+      int v = (int)(r * tex->height) % tex->height;
 
       if (u < 0)
-        u += pigment.textureWidth;
+        u += tex->width;
       if (v < 0)
-        v += pigment.textureHeight;
+        v += tex->height;
 
-      int idx = v * pigment.textureWidth + u;
-      if (idx >= 0 && idx < (int)pigment.textureData.size()) {
-        return pigment.textureData[idx];
+      int idx = v * tex->width + u;
+      if (idx >= 0 && idx < (int)tex->data.size()) {
+        return tex->data[idx];
       }
     }
 
     return pigment.color1;
   }
+}
+
+// Obtem cor do pigmento em um ponto
+Vec3 getPigmentColor(const Pigment &pigment, const Vec3 &point) {
+  if (pigment.type == SOLID) {
+    return pigmentColor<SOLID>(pigment, point);
+  } else if (pigment.type == CHECKER) {
+    return pigmentColor<CHECKER>(pigment, point);
+  } else if (pigment.type == TEXMAP) {
+    return pigmentColor<TEXMAP>(pigment, point);
+  }
 
   return Vec3(1, 1, 1);
 }
@@ -0,0 +1,152 @@
+#ifndef REACH_H
+#define REACH_H
+
+#include "structures.h"
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Grade que registra por onde passaram os raios de um bloco da imagem
+const int REACH_GRID_SIZE = 16; // Células por eixo
+const int REACH_CELLS = REACH_GRID_SIZE * REACH_GRID_SIZE * REACH_GRID_SIZE;
+const int REACH_COMPACT_SIZE = 4096; // Compacta a lista de objetos ao atingir
+
+// Região do espaço coberta pela grade de alcance. Fora dela os segmentos
+// não são registrados: quem editar geometria que sai da grade precisa
+// renderizar tudo de novo (ver renderIncremental).
+struct ReachGrid {
+  AABB box;
+  Vec3 cellSize;
+
+  ReachGrid() {}
+
+  explicit ReachGrid(const AABB &region) : box(region) {
+    cellSize = (box.max - box.min) / (double)REACH_GRID_SIZE;
+  }
+
+  // Célula de um ponto, limitada à grade
+  void cellOf(const Vec3 &p, int cell[3]) const {
+    double rel[3] = {(p.x - box.min.x) / cellSize.x,
+                     (p.y - box.min.y) / cellSize.y,
+                     (p.z - box.min.z) / cellSize.z};
+    for (int axis = 0; axis < 3; axis++)
+      cell[axis] = std::min(REACH_GRID_SIZE - 1,
+                            std::max(0, (int)floor(rel[axis])));
+  }
+};
+
+// Dependências registradas durante a renderização de um bloco: objetos
+// atingidos pelo primeiro hit, objetos atingidos por raios secundários e as
+// células da grade cruzadas por qualquer segmento de raio (primário,
+// secundário ou de sombra)
+struct TileRecord {
+  std::vector<int> firstHits;
+  std::vector<int> objects;
+  std::bitset<REACH_CELLS> cells;
+
+  // Hits consecutivos costumam repetir o objeto
+  static void addTo(std::vector<int> &list, int objectIdx) {
+    if (!list.empty() && list.back() == objectIdx)
+      return;
+    list.push_back(objectIdx);
+    if (list.size() >= REACH_COMPACT_SIZE)
+      compactList(list);
+  }
+
+  static void compactList(std::vector<int> &list) {
+    std::sort(list.begin(), list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+  }
+
+  void addFirstHit(int objectIdx) { addTo(firstHits, objectIdx); }
+  void addObject(int objectIdx) { addTo(objects, objectIdx); }
+
+  // Ordena e remove repetições (as listas ficam prontas para busca binária)
+  void compact() {
+    compactList(firstHits);
+    compactList(objects);
+  }
+
+  // Acumula outro registro do mesmo bloco
+  void merge(const TileRecord &other) {
+    firstHits.insert(firstHits.end(), other.firstHits.begin(),
+                     other.firstHits.end());
+    objects.insert(objects.end(), other.objects.begin(), other.objects.end());
+    cells |= other.cells;
+    compact();
+  }
+
+  // Marca as células cruzadas pelo segmento [0, tMax] do raio (tMax pode
+  // ser infinito) com o percurso de Amanatides e Woo
+  void addSegment(const ReachGrid &grid, const Ray &ray, double tMax) {
+    double t0 = 0.0, t1 = tMax;
+    double o[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+    double d[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+    double lo[3] = {grid.box.min.x, grid.box.min.y, grid.box.min.z};
+    double hi[3] = {grid.box.max.x, grid.box.max.y, grid.box.max.z};
+    double size[3] = {grid.cellSize.x, grid.cellSize.y, grid.cellSize.z};
+    for (int axis = 0; axis < 3; axis++) {
+      if (d[axis] == 0.0) {
+        if (o[axis] < lo[axis] || o[axis] > hi[axis])
+          return;
+        continue;
+      }
+      double ta = (lo[axis] - o[axis]) / d[axis];
+      double tb = (hi[axis] - o[axis]) / d[axis];
+      t0 = std::max(t0, std::min(ta, tb));
+      t1 = std::min(t1, std::max(ta, tb));
+    }
+    if (t0 > t1)
+      return;
+
+    int cell[3], step[3];
+    double tNext[3], tDelta[3];
+    grid.cellOf(ray.at(t0), cell);
+    for (int axis = 0; axis < 3; axis++) {
+      if (d[axis] == 0.0) {
+        step[axis] = 0;
+        tNext[axis] = tDelta[axis] = std::numeric_limits<double>::infinity();
+        continue;
+      }
+      step[axis] = d[axis] > 0 ? 1 : -1;
+      double boundary = lo[axis] + (cell[axis] + (d[axis] > 0)) * size[axis];
+      tNext[axis] = (boundary - o[axis]) / d[axis];
+      tDelta[axis] = size[axis] / fabs(d[axis]);
+    }
+
+    while (true) {
+      cells.set((cell[2] * REACH_GRID_SIZE + cell[1]) * REACH_GRID_SIZE +
+                cell[0]);
+      int axis = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2)
+                                     : (tNext[1] < tNext[2] ? 1 : 2);
+      if (tNext[axis] > t1)
+        break;
+      cell[axis] += step[axis];
+      if (cell[axis] < 0 || cell[axis] >= REACH_GRID_SIZE)
+        break;
+      tNext[axis] += tDelta[axis];
+    }
+  }
+
+  // Algum segmento pode ter cruzado a caixa? Os erros de arredondamento do
+  // percurso são cobertos com uma célula a mais em cada direção.
+  bool touches(const ReachGrid &grid, const AABB &box) const {
+    int c0[3], c1[3];
+    grid.cellOf(box.min, c0);
+    grid.cellOf(box.max, c1);
+    for (int axis = 0; axis < 3; axis++) {
+      c0[axis] = std::max(0, c0[axis] - 1);
+      c1[axis] = std::min(REACH_GRID_SIZE - 1, c1[axis] + 1);
+    }
+    for (int z = c0[2]; z <= c1[2]; z++)
+      for (int y = c0[1]; y <= c1[1]; y++)
+        for (int x = c0[0]; x <= c1[0]; x++)
+          if (cells.test((z * REACH_GRID_SIZE + y) * REACH_GRID_SIZE + x))
+            return true;
+    return false;
+  }
+};
+
+#endif
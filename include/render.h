@@ -0,0 +1,663 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "denoise.h"
+#include "reach.h"
+#include "sampler.h"
+#include "shading.h"
+#include "structures.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <omp.h>
+#include <string>
+#include <vector>
+
+// Parâmetros de uma renderização (podem ser sobrescritos por linha de comando)
+struct RenderSettings {
+  int width;
+  int height;
+  int samples;      // Número de amostras por pixel (Distributed Ray Tracing)
+  double aperture;  // Raio da abertura da lente (0 = sem DOF)
+  double focusDist; // Distância focal
+  bool denoise;     // Aplica o filtro guiado pelos AOVs após a renderização
+  SamplerType sampler;
+  uint32_t seed; // Semente das amostras (mesma semente, mesma imagem)
+  ShadingOptions shading;
+  int pilotScale; // Redução do passo piloto (0 = sem piloto, ver renderScene)
+  bool irradianceCache; // Reaproveita a visibilidade das luzes entre hits
+  int shadowMapSize;    // Mapas de sombra com esta resolução (0 = raios)
+
+  RenderSettings()
+      : width(800), height(600), samples(16), aperture(0.0), focusDist(10.0),
+        denoise(false), sampler(SAMPLER_SOBOL), seed(0), pilotScale(0),
+        irradianceCache(false), shadowMapSize(0) {}
+};
+
+// Câmera de uma vista: a da cena (ver sceneCamera) ou uma das vistas
+// renderizadas juntas por renderViews
+struct Camera {
+  std::string name; // Sufixo do arquivo de saída da vista
+  Vec3 eye, lookAt, up;
+  double fovy;
+
+  Camera() : up(0, 1, 0), fovy(40) {}
+};
+
+Camera sceneCamera(const Scene &scene) {
+  Camera camera;
+  camera.eye = scene.eye;
+  camera.lookAt = scene.lookAt;
+  camera.up = scene.up;
+  camera.fovy = scene.fovy;
+  return camera;
+}
+
+// Raios primários de uma vista: base da câmera, plano de imagem a uma
+// unidade do olho e, sem DOF, os termos de origem comuns a todos os raios
+struct PrimaryView {
+  Vec3 eye, u, v, w;
+  double viewportWidth, viewportHeight;
+  OriginCache originCache;
+  bool pinhole; // Sem DOF: todos os raios partem do olho
+};
+
+// Configuração da câmera
+void setupCamera(const Scene &scene, const Camera &camera,
+                 const RenderSettings &settings, PrimaryView &view) {
+  view.eye = camera.eye;
+  view.w = (camera.eye - camera.lookAt).normalize();
+  view.u = camera.up.cross(view.w).normalize();
+  view.v = camera.up.normalize();
+  double aspectRatio = (double)(settings.width) / (double)(settings.height);
+
+  double fovyRad = camera.fovy * M_PI / 180.0;
+  view.viewportHeight = 2.0 * tan(fovyRad / 2.0);
+  view.viewportWidth = view.viewportHeight * aspectRatio;
+
+  view.pinhole = settings.aperture <= 0.0;
+  if (view.pinhole)
+    buildOriginCache(scene, camera.eye, view.originCache);
+}
+
+// Converte uma cor em [0, 1] para o buffer de quadros
+void storePixel(std::vector<unsigned char> &frameBuffer, int idx,
+                const Vec3 &color) {
+  frameBuffer[idx + 0] = (unsigned char)(color.x * 255);
+  frameBuffer[idx + 1] = (unsigned char)(color.y * 255);
+  frameBuffer[idx + 2] = (unsigned char)(color.z * 255);
+}
+
+// Região retangular da imagem [x0, x1) x [y0, y1) com custo estimado
+struct Tile {
+  int x0, y0, x1, y1;
+  double cost;
+};
+
+// Escalonamento guiado pelo passo piloto
+const int TILE_SIZE = 32;              // Lado dos blocos iniciais
+const int TILE_MIN_SIZE = 8;           // Blocos menores não são divididos
+const double TILE_SPLIT_FACTOR = 4.0;  // Custo (em médias) que leva à divisão
+const int TILES_PER_THREAD = 4;        // Blocos de custo médio por thread
+const int PILOT_DEFAULT_SCALE = 4;     // Redução usada só com --preview
+
+// Recebe a prévia (imagem do passo piloto) assim que ela fica pronta
+typedef std::function<void(const std::vector<unsigned char> &image, int width,
+                           int height)>
+    PreviewCallback;
+
+// Blocos de TILE_SIZE cobrindo a imagem, linha a linha
+std::vector<Tile> tileGrid(const RenderSettings &settings) {
+  std::vector<Tile> tiles;
+  for (int y = 0; y < settings.height; y += TILE_SIZE)
+    for (int x = 0; x < settings.width; x += TILE_SIZE)
+      tiles.push_back({x, y, std::min(x + TILE_SIZE, settings.width),
+                       std::min(y + TILE_SIZE, settings.height), 0.0});
+  return tiles;
+}
+
+// Custo estimado de uma região: cada pixel vale o tempo medido no pixel
+// correspondente do piloto
+double tileCost(const std::vector<double> &pilotCost, int pilotWidth,
+                int pilotHeight, const RenderSettings &settings, int x0,
+                int y0, int x1, int y1) {
+  double cost = 0.0;
+  for (int y = y0; y < y1; y++) {
+    int py = std::min(pilotHeight - 1, y * pilotHeight / settings.height);
+    for (int x = x0; x < x1; x++) {
+      int px = std::min(pilotWidth - 1, x * pilotWidth / settings.width);
+      cost += pilotCost[py * pilotWidth + px];
+    }
+  }
+  return cost;
+}
+
+// Divide em quatro, recursivamente, os blocos mais caros que o limite
+void splitTile(const Tile &tile, double limit,
+               const std::vector<double> &pilotCost, int pilotWidth,
+               int pilotHeight, const RenderSettings &settings,
+               std::vector<Tile> &tiles) {
+  int w = tile.x1 - tile.x0, h = tile.y1 - tile.y0;
+  if (tile.cost <= limit || (w <= TILE_MIN_SIZE && h <= TILE_MIN_SIZE)) {
+    tiles.push_back(tile);
+    return;
+  }
+  int xm = w > TILE_MIN_SIZE ? tile.x0 + w / 2 : tile.x1;
+  int ym = h > TILE_MIN_SIZE ? tile.y0 + h / 2 : tile.y1;
+  int xs[3] = {tile.x0, xm, tile.x1}, ys[3] = {tile.y0, ym, tile.y1};
+  for (int j = 0; j < 2; j++) {
+    for (int i = 0; i < 2; i++) {
+      Tile part = {xs[i], ys[j], xs[i + 1], ys[j + 1], 0.0};
+      if (part.x0 == part.x1 || part.y0 == part.y1)
+        continue;
+      part.cost = tileCost(pilotCost, pilotWidth, pilotHeight, settings,
+                           part.x0, part.y0, part.x1, part.y1);
+      splitTile(part, limit, pilotCost, pilotWidth, pilotHeight, settings,
+                tiles);
+    }
+  }
+}
+
+// Monta a fila de blocos a partir do custo por pixel do piloto: blocos de
+// TILE_SIZE, subdivididos os que custam mais que TILE_SPLIT_FACTOR vezes a
+// média ou mais que a fatia de uma thread (TILES_PER_THREAD blocos por
+// thread), em ordem decrescente de custo: os maiores primeiro, para que os
+// últimos a terminar sejam pequenos
+std::vector<Tile> scheduleTiles(const std::vector<double> &pilotCost,
+                                int pilotWidth, int pilotHeight,
+                                const RenderSettings &settings, int threads) {
+  std::vector<Tile> initial = tileGrid(settings);
+  double total = 0.0;
+  for (Tile &tile : initial) {
+    tile.cost = tileCost(pilotCost, pilotWidth, pilotHeight, settings,
+                         tile.x0, tile.y0, tile.x1, tile.y1);
+    total += tile.cost;
+  }
+
+  double limit = std::min(TILE_SPLIT_FACTOR * total / initial.size(),
+                          total / (threads * TILES_PER_THREAD));
+  std::vector<Tile> tiles;
+  for (const Tile &tile : initial)
+    splitTile(tile, limit, pilotCost, pilotWidth, pilotHeight, settings,
+              tiles);
+  std::stable_sort(
+      tiles.begin(), tiles.end(),
+      [](const Tile &a, const Tile &b) { return a.cost > b.cost; });
+  return tiles;
+}
+
+// Renderiza as amostras do pixel (x, y) da vista e guarda a média no
+// buffer de quadros (e os AOVs, se aov não for nulo)
+void renderPixel(const Scene &scene, const RenderSettings &settings,
+                 const PrimaryView &view, int x, int y, Sampler &sampler,
+                 const ShadingOptions &shading,
+                 std::vector<unsigned char> &frameBuffer, AOVBuffers *aov) {
+  Vec3 pixelColor(0, 0, 0);
+  Vec3 albedo(0, 0, 0), normal(0, 0, 0);
+  double depth = 0.0, lumSum = 0.0, lumSqSum = 0.0;
+  int objectId = -1;
+
+  // Superamostragem
+  for (int s = 0; s < settings.samples; s++) {
+    // Jittering - deslocamento dentro do pixel
+    double jitterX, jitterY;
+    sampler.startPixelSample(x, y, s);
+    sampler.setDimension(SAMPLE_DIM_PIXEL);
+    sampler.get2D(jitterX, jitterY);
+
+    // Calcula coordenadas normalizadas do dispositivo com jitter
+    double ndcX = (2.0 * (x + jitterX) / settings.width) - 1.0;
+    double ndcY = 1.0 - (2.0 * (y + jitterY) / settings.height);
+
+    // Calcula direção do raio (sem DOF)
+    Vec3 rayDir = view.u * (ndcX * view.viewportWidth / 2.0) +
+                  view.v * (ndcY * view.viewportHeight / 2.0) - view.w;
+    rayDir = rayDir.normalize();
+
+    // DoF - Amostra ponto no disco da abertura
+    Vec3 rayOrigin = view.eye;
+    if (settings.aperture > 0.0) {
+      // Mapeamento concêntrico do quadrado para o disco unitário
+      double lensU, lensV, dx, dy;
+      sampler.setDimension(SAMPLE_DIM_LENS);
+      sampler.get2D(lensU, lensV);
+      concentricSampleDisk(lensU, lensV, dx, dy);
+
+      // Offset da origem do raio na abertura
+      Vec3 offset = view.u * (dx * settings.aperture) +
+                    view.v * (dy * settings.aperture);
+      rayOrigin = view.eye + offset;
+
+      // Ponto de foco na distância focal
+      Vec3 focusPoint = view.eye + rayDir * settings.focusDist;
+
+      // Nova direção do raio da origem offset para o ponto de foco
+      rayDir = (focusPoint - rayOrigin).normalize();
+    }
+
+    Ray ray(rayOrigin, rayDir);
+    HitInfo hit = findClosestHit(
+        ray, scene, view.pinhole ? &view.originCache : nullptr);
+    if (shading.rayCount)
+      ++*shading.rayCount;
+    if (shading.record) {
+      double reach = std::numeric_limits<double>::infinity();
+      if (hit.hit) {
+        reach = hit.t;
+        shading.record->addFirstHit(hit.objectIdx);
+      }
+      shading.record->addSegment(*shading.reachGrid, ray, reach);
+    }
+    Vec3 sampleColor(0, 0, 0); // Cor de fundo - preto
+    if (hit.hit)
+      sampleColor = shade(hit, scene, ray, 0, sampler, shading);
+    pixelColor = pixelColor + sampleColor;
+
+    if (aov) {
+      double lum = luminance(sampleColor);
+      lumSum += lum;
+      lumSqSum += lum * lum;
+
+      int id = hit.hit ? hit.objectIdx : -1;
+      if (s == 0)
+        objectId = id;
+      else if (id != objectId)
+        objectId = AOV_MIXED;
+
+      if (hit.hit) {
+        const SceneItem &obj = sceneItem(scene, hit.objectIdx);
+        albedo = albedo + getPigmentColor(scene.pigments[obj.pigmentIdx],
+                                          hit.point);
+        normal = normal + hit.normal;
+        depth += hit.t;
+      }
+    }
+  }
+
+  // Média das amostras (com luzes sorteadas, as amostras não são limitadas)
+  pixelColor = pixelColor / (double)settings.samples;
+
+  // Armazena a cor no buffer de quadros
+  int idx = (y * settings.width + x) * 3;
+  storePixel(frameBuffer, idx, pixelColor.clamp());
+
+  if (aov) {
+    int p = y * settings.width + x;
+    aov->color[p] = pixelColor;
+
+    // Variância da média; com uma amostra não há estimativa do ruído
+    double n = settings.samples;
+    double meanLum = lumSum / n;
+    double sampleVar = std::max(0.0, lumSqSum / n - meanLum * meanLum);
+    aov->variance[p] = n > 1 ? sampleVar / (n - 1) : 1.0;
+    aov->albedo[p] = albedo / (double)settings.samples;
+    aov->normal[p] = normal.normalize();
+    aov->depth[p] = depth / (double)settings.samples;
+    aov->objectId[p] = objectId;
+  }
+}
+
+// Renderiza a imagem inteira: por blocos, na ordem dada, ou por linhas se
+// tiles estiver vazio. Se pixelCost não for nulo, guarda o tempo de cada
+// pixel (em segundos). Se records não for nulo, registra as dependências de
+// cada bloco em (*records)[i] (grade dada por reachGrid); com pixelMask,
+// só os pixels marcados são renderizados e os demais ficam como estão.
+void renderPixels(const Scene &scene, const RenderSettings &settings,
+                  std::vector<unsigned char> &frameBuffer, AOVBuffers *aov,
+                  const std::vector<Tile> &tiles,
+                  std::vector<double> *pixelCost,
+                  std::vector<TileRecord> *records = nullptr,
+                  const ReachGrid *reachGrid = nullptr,
+                  const std::vector<char> *pixelMask = nullptr) {
+  PrimaryView view;
+  setupCamera(scene, sceneCamera(scene), settings, view);
+
+  frameBuffer.resize(settings.width * settings.height * 3);
+  if (pixelCost)
+    pixelCost->assign(settings.width * settings.height, 0.0);
+
+  ShadingOptions shading = settings.shading;
+  shading.lensRadius = settings.aperture;
+
+  auto renderPixelAt = [&](int x, int y, Sampler &sampler,
+                           const ShadingOptions &shading) {
+    if (pixelMask && !(*pixelMask)[y * settings.width + x])
+      return;
+    renderPixel(scene, settings, view, x, y, sampler, shading, frameBuffer,
+                aov);
+  };
+
+  // Mede o pixel só quando o custo foi pedido (passo piloto)
+  auto timedPixel = [&](int x, int y, Sampler &sampler,
+                        const ShadingOptions &shading) {
+    if (!pixelCost) {
+      renderPixelAt(x, y, sampler, shading);
+      return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    renderPixelAt(x, y, sampler, shading);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    (*pixelCost)[y * settings.width + x] = elapsed.count();
+  };
+
+  // Cada linha ou bloco conta os raios num contador próprio, somado ao
+  // total pedido em settings.shading.rayCount ao terminar
+  uint64_t *totalRays = settings.shading.rayCount;
+  auto addRays = [totalRays](uint64_t rays) {
+    if (totalRays) {
+#pragma omp atomic
+      *totalRays += rays;
+    }
+  };
+
+  if (tiles.empty()) {
+    // Linhas distribuídas entre as threads do OpenMP
+#pragma omp parallel for schedule(dynamic)
+    for (int y = 0; y < settings.height; y++) {
+      Sampler sampler(settings.sampler, settings.samples, settings.seed);
+      uint64_t rays = 0;
+      ShadingOptions rowShading = shading;
+      if (totalRays)
+        rowShading.rayCount = &rays;
+      for (int x = 0; x < settings.width; x++)
+        timedPixel(x, y, sampler, rowShading);
+      addRays(rays);
+    }
+    return;
+  }
+
+  // Blocos na ordem da fila: cada thread pega o próximo ao terminar
+#pragma omp parallel for schedule(dynamic, 1)
+  for (size_t i = 0; i < tiles.size(); i++) {
+    Sampler sampler(settings.sampler, settings.samples, settings.seed);
+    const Tile &tile = tiles[i];
+    uint64_t rays = 0;
+    ShadingOptions tileShading = shading;
+    if (totalRays)
+      tileShading.rayCount = &rays;
+    if (records) {
+      tileShading.record = &(*records)[i];
+      tileShading.reachGrid = reachGrid;
+    }
+    for (int y = tile.y0; y < tile.y1; y++)
+      for (int x = tile.x0; x < tile.x1; x++)
+        timedPixel(x, y, sampler, tileShading);
+    if (records)
+      (*records)[i].compact();
+    addRays(rays);
+  }
+}
+
+// Cria um registro do cache no hit. A visibilidade de cada luz é a fração
+// dos IRRADIANCE_SHADOW_SAMPLES raios de sombra, estratificados no cubo da
+// luz, que a alcançam. O raio de validade é IRRADIANCE_RADIUS_SCALE vezes
+// o espaçamento (spacing, no mundo), limitado perto de oclusores, onde a
+// sombra muda mais depressa.
+void addIrradianceRecord(const Scene &scene, const HitInfo &hit,
+                         double spacing, uint32_t seed,
+                         const ShadingOptions &options,
+                         IrradianceRecord &record,
+                         std::vector<float> &visibility) {
+  // Estratos de 4 colunas no plano xy do cubo (z sorteado)
+  const int columns = 4, rows = IRRADIANCE_SHADOW_SAMPLES / columns;
+  double nearest = std::numeric_limits<double>::infinity();
+  for (int i = 1; i <= (int)visibility.size(); i++) {
+    int visible = 0;
+    for (int s = 0; s < IRRADIANCE_SHADOW_SAMPLES; s++) {
+      uint32_t h = hashCombine(hashCombine(seed, i), s);
+      double r1 = (s % columns + toUnit(hashCombine(h, 0))) / columns;
+      double r2 = (s / columns + toUnit(hashCombine(h, 1))) / rows;
+      double r3 = toUnit(hashCombine(h, 2));
+      Vec3 offset(r1 * 2.0 - 1.0, r2 * 2.0 - 1.0, r3 * 2.0 - 1.0);
+      Vec3 samplePos = scene.lights[i].position + offset * LIGHT_RADIUS;
+      double occluderDist = std::numeric_limits<double>::infinity();
+      if (lightVisible(hit, scene, i, samplePos, options, &occluderDist))
+        visible++;
+      // Amostras atrás da superfície são bloqueadas pelo próprio objeto,
+      // o que não indica sombra projetada por perto
+      if (hit.normal.dot(samplePos - hit.point) > 0)
+        nearest = std::min(nearest, occluderDist);
+    }
+    visibility[i - 1] = (float)visible / IRRADIANCE_SHADOW_SAMPLES;
+  }
+
+  record.position = hit.point;
+  record.normal = hit.normal;
+  record.objectIdx = hit.objectIdx;
+  record.radius = std::min(IRRADIANCE_RADIUS_SCALE * spacing,
+                           IRRADIANCE_OCCLUDER_SCALE * nearest);
+}
+
+// Preenche o cache de irradiância a partir dos hits primários no centro dos
+// pixels, em níveis: primeiro a cada IRRADIANCE_STRIDE pixels e depois,
+// com espaçamento pela metade até IRRADIANCE_MIN_STRIDE, só onde os
+// registros existentes não cobrem o ponto ou discordam (bordas de objetos
+// e de sombras). Cada nível é calculado em paralelo e inserido na ordem
+// dos pixels, então o cache não depende do número de threads. Com mais de
+// IRRADIANCE_MAX_LIGHTS luzes, ou quando elas são sorteadas, fica vazio.
+void buildIrradianceCache(const Scene &scene, const Camera &camera,
+                          const RenderSettings &settings,
+                          IrradianceCache &cache) {
+  cache = IrradianceCache();
+  cache.lights = (int)scene.lights.size() - 1;
+  if (cache.lights <= 0 || cache.lights > IRRADIANCE_MAX_LIGHTS ||
+      !sampleAllLights(scene, settings.shading))
+    return;
+
+  PrimaryView view;
+  setupCamera(scene, camera, settings, view);
+  // Lado de um pixel a uma unidade de distância do olho
+  double pixelAngle = view.viewportHeight / settings.height;
+
+  uint64_t *totalRays = settings.shading.rayCount;
+  for (int stride = IRRADIANCE_STRIDE; stride >= IRRADIANCE_MIN_STRIDE;
+       stride /= 2) {
+    // Pixels do nível que não pertencem ao nível anterior
+    std::vector<int> pixels;
+    for (int y = 0; y < settings.height; y += stride)
+      for (int x = 0; x < settings.width; x += stride)
+        if (stride == IRRADIANCE_STRIDE || x % (2 * stride) != 0 ||
+            y % (2 * stride) != 0)
+          pixels.push_back(y * settings.width + x);
+
+    std::vector<IrradianceRecord> records(pixels.size());
+    std::vector<float> visibility(pixels.size() * cache.lights);
+    std::vector<char> created(pixels.size(), 0);
+
+#pragma omp parallel
+    {
+      uint64_t rays = 0;
+      ShadingOptions shading = settings.shading;
+      shading.rayCount = totalRays ? &rays : nullptr;
+      std::vector<float> local(cache.lights);
+      float cached[IRRADIANCE_MAX_LIGHTS];
+
+#pragma omp for schedule(dynamic, 16)
+      for (size_t k = 0; k < pixels.size(); k++) {
+        int x = pixels[k] % settings.width, y = pixels[k] / settings.width;
+        double ndcX = (2.0 * (x + 0.5) / settings.width) - 1.0;
+        double ndcY = 1.0 - (2.0 * (y + 0.5) / settings.height);
+        Vec3 rayDir = view.u * (ndcX * view.viewportWidth / 2.0) +
+                      view.v * (ndcY * view.viewportHeight / 2.0) - view.w;
+        Ray ray(view.eye, rayDir);
+        HitInfo hit = findClosestHit(ray, scene);
+        if (totalRays)
+          rays++;
+        if (!hit.hit ||
+            scene.finishes[sceneItem(scene, hit.objectIdx).finishIdx].kd <= 0 ||
+            lookupIrradiance(cache, hit.point, hit.normal, hit.objectIdx,
+                             cached) == cache.lights)
+          continue;
+
+        // Espaçamento no mundo; em ângulos rasantes o pixel se alonga na
+        // superfície por 1 / cos (limitado a IRRADIANCE_MAX_STRETCH)
+        double cosView = fabs(hit.normal.dot(ray.direction));
+        double spacing = stride * pixelAngle * hit.t /
+                         std::max(cosView, 1.0 / IRRADIANCE_MAX_STRETCH);
+        addIrradianceRecord(scene, hit, spacing,
+                            hashCombine(settings.seed, pixels[k]), shading,
+                            records[k], local);
+        std::copy(local.begin(), local.end(),
+                  visibility.begin() + k * cache.lights);
+        created[k] = 1;
+      }
+
+      if (totalRays) {
+#pragma omp atomic
+        *totalRays += rays;
+      }
+    }
+
+    size_t first = cache.records.size();
+    for (size_t k = 0; k < pixels.size(); k++) {
+      if (!created[k])
+        continue;
+      cache.records.push_back(records[k]);
+      cache.visibility.insert(cache.visibility.end(),
+                              visibility.begin() + k * cache.lights,
+                              visibility.begin() + (k + 1) * cache.lights);
+    }
+    clampIrradianceRecords(cache, first);
+  }
+}
+
+// Renderização da cena. Se aov não for nulo, também preenche os buffers
+// auxiliares do primeiro hit (necessários para o denoise). Com pilotScale,
+// um passo piloto em resolução reduzida e uma amostra por pixel estima o
+// custo de cada região e define a fila de blocos; a imagem do piloto é
+// entregue a onPreview antes da renderização final. O amostrador depende
+// só do pixel, então a ordem dos blocos não altera a imagem.
+void renderScene(const Scene &scene, const RenderSettings &settings,
+                 std::vector<unsigned char> &frameBuffer,
+                 AOVBuffers *aov = nullptr,
+                 const PreviewCallback &onPreview = nullptr) {
+  // Mapas de sombra e cache valem para esta cena (e câmera); são montados
+  // antes do piloto, para que o custo medido já considere os raios de
+  // sombra economizados
+  if (settings.shadowMapSize > 0 || settings.irradianceCache) {
+    ShadowMaps shadowMaps;
+    IrradianceCache irradiance;
+    RenderSettings prepared = settings;
+    prepared.shadowMapSize = 0;
+    prepared.irradianceCache = false;
+    if (settings.shadowMapSize > 0) {
+      buildShadowMaps(scene, settings.shadowMapSize, settings.aperture,
+                      shadowMaps, settings.shading.rayCount);
+      prepared.shading.shadowMaps = &shadowMaps;
+    }
+    if (settings.irradianceCache) {
+      buildIrradianceCache(scene, sceneCamera(scene), settings, irradiance);
+      prepared.shading.irradiance = &irradiance;
+    }
+    renderScene(scene, prepared, frameBuffer, aov, onPreview);
+    return;
+  }
+
+  AOVBuffers localAOV;
+  if (!aov && settings.denoise)
+    aov = &localAOV;
+  if (aov)
+    aov->resize(settings.width, settings.height);
+
+  std::vector<Tile> tiles;
+  if (settings.pilotScale > 1) {
+    RenderSettings pilot = settings;
+    pilot.width = std::max(1, settings.width / settings.pilotScale);
+    pilot.height = std::max(1, settings.height / settings.pilotScale);
+    pilot.samples = 1;
+    pilot.denoise = false;
+    pilot.pilotScale = 0;
+
+    std::vector<unsigned char> preview;
+    std::vector<double> pilotCost;
+    renderPixels(scene, pilot, preview, nullptr, tiles, &pilotCost);
+    if (onPreview)
+      onPreview(preview, pilot.width, pilot.height);
+    tiles = scheduleTiles(pilotCost, pilot.width, pilot.height, settings,
+                          omp_get_max_threads());
+  }
+
+  renderPixels(scene, settings, frameBuffer, aov, tiles, nullptr);
+
+  if (settings.denoise) {
+    denoiseAtrous(*aov);
+    for (int p = 0; p < settings.width * settings.height; p++)
+      storePixel(frameBuffer, p * 3, aov->color[p].clamp());
+  }
+}
+
+// Tempo de renderização e raios traçados (lidos pelo perfgate, ver tools/)
+void printRenderStats(double seconds, uint64_t rays, std::ostream &out) {
+  out << "Tempo de renderização: " << seconds << " s" << std::endl;
+  out << "Raios traçados: " << rays << " ("
+      << (uint64_t)(seconds > 0 ? rays / seconds : 0) << " por segundo)"
+      << std::endl;
+}
+
+// Salva a imagem em um arquivo PPM
+bool savePPM(const std::string &filename,
+             const std::vector<unsigned char> &frameBuffer, int width,
+             int height) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Erro: Não foi possível criar o arquivo de saída " << filename
+              << std::endl;
+    return false;
+  }
+
+  file << "P3\n";
+  file << "# Imagem raytracing\n";
+  file << width << " " << height << "\n";
+  file << "255\n";
+
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      int idx = (y * width + x) * 3;
+      file << (int)frameBuffer[idx + 0] << " " << (int)frameBuffer[idx + 1]
+           << " " << (int)frameBuffer[idx + 2] << " ";
+    }
+    file << "\n";
+  }
+
+  file.close();
+  return true;
+}
+
+// Salva os AOVs como imagens PPM: <prefixo>_albedo, _normal, _depth e _id
+bool saveAOVs(const std::string &prefix, const AOVBuffers &aov) {
+  int numPixels = aov.width * aov.height;
+  std::vector<unsigned char> albedo(numPixels * 3), normal(numPixels * 3),
+      depth(numPixels * 3), id(numPixels * 3);
+
+  double maxDepth = 0.0;
+  for (int p = 0; p < numPixels; p++)
+    maxDepth = std::max(maxDepth, aov.depth[p]);
+
+  for (int p = 0; p < numPixels; p++) {
+    storePixel(albedo, p * 3, aov.albedo[p].clamp());
+    storePixel(normal, p * 3, (aov.normal[p] * 0.5 + Vec3(0.5, 0.5, 0.5)));
+    double d = maxDepth > 0 ? aov.depth[p] / maxDepth : 0.0;
+    storePixel(depth, p * 3, Vec3(d, d, d));
+
+    // Cor pseudo-aleatória por objeto
+    Vec3 idColor(0, 0, 0);
+    if (aov.objectId[p] >= 0) {
+      unsigned int h = (unsigned int)(aov.objectId[p] + 1) * 2654435761u;
+      idColor = Vec3((h & 255) / 255.0, ((h >> 8) & 255) / 255.0,
+                     ((h >> 16) & 255) / 255.0);
+    }
+    storePixel(id, p * 3, idColor);
+  }
+
+  return savePPM(prefix + "_albedo.ppm", albedo, aov.width, aov.height) &&
+         savePPM(prefix + "_normal.ppm", normal, aov.width, aov.height) &&
+         savePPM(prefix + "_depth.ppm", depth, aov.width, aov.height) &&
+         savePPM(prefix + "_id.ppm", id, aov.width, aov.height);
+}
+
+#endif
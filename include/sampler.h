@@ -0,0 +1,239 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+// Tipos de amostrador
+enum SamplerType {
+  SAMPLER_RANDOM,
+  SAMPLER_STRATIFIED,
+  SAMPLER_HALTON,
+  SAMPLER_SOBOL
+};
+
+// Primeiras dimensões de cada amostra; as seguintes pertencem aos rebotes
+const int SAMPLE_DIM_PIXEL = 0;  // Jitter dentro do pixel (2D)
+const int SAMPLE_DIM_LENS = 2;   // Ponto no disco da abertura (2D)
+const int SAMPLE_DIM_BOUNCE = 4; // Início das dimensões do primeiro rebote
+
+// Hash de 32 bits (lowbias32)
+uint32_t hashUint(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7feb352d;
+  x ^= x >> 15;
+  x *= 0x846ca68b;
+  x ^= x >> 16;
+  return x;
+}
+
+uint32_t hashCombine(uint32_t seed, uint32_t value) {
+  return hashUint(seed ^ (hashUint(value) + 0x9e3779b9 + (seed << 6) +
+                          (seed >> 2)));
+}
+
+// Converte 32 bits para [0, 1)
+double toUnit(uint32_t x) { return x * (1.0 / 4294967296.0); }
+
+uint32_t reverseBits(uint32_t x) {
+  x = (x << 16) | (x >> 16);
+  x = ((x & 0x00ff00ff) << 8) | ((x & 0xff00ff00) >> 8);
+  x = ((x & 0x0f0f0f0f) << 4) | ((x & 0xf0f0f0f0) >> 4);
+  x = ((x & 0x33333333) << 2) | ((x & 0xcccccccc) >> 2);
+  x = ((x & 0x55555555) << 1) | ((x & 0xaaaaaaaa) >> 1);
+  return x;
+}
+
+// Embaralhamento de Owen por hash (Burley 2020, permutação Laine-Karras)
+uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+  x = reverseBits(x);
+  x += seed;
+  x ^= x * 0x6c50b47c;
+  x ^= x * 0xb82f1e52;
+  x ^= x * 0xc7afe638;
+  x ^= x * 0x8d22f6e6;
+  return reverseBits(x);
+}
+
+// Segunda dimensão de Sobol (polinômio x + 1); a primeira é reverseBits(i)
+uint32_t sobolDimension1(uint32_t index) {
+  uint32_t result = 0;
+  for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+    if (index & 1)
+      result ^= v;
+  return result;
+}
+
+// Permutação de [0, length) definida pela semente (Kensler 2013)
+uint32_t permuteIndex(uint32_t i, uint32_t length, uint32_t seed) {
+  uint32_t w = length - 1;
+  w |= w >> 1;
+  w |= w >> 2;
+  w |= w >> 4;
+  w |= w >> 8;
+  w |= w >> 16;
+  do {
+    i ^= seed;
+    i *= 0xe170893d;
+    i ^= seed >> 16;
+    i ^= (i & w) >> 4;
+    i ^= seed >> 8;
+    i *= 0x0929eb3f;
+    i ^= seed >> 23;
+    i ^= (i & w) >> 1;
+    i *= 1 | seed >> 27;
+    i *= 0x6935fa69;
+    i ^= (i & w) >> 11;
+    i *= 0x74dcb303;
+    i ^= (i & w) >> 2;
+    i *= 0x9e501cc3;
+    i ^= (i & w) >> 2;
+    i *= 0xc860a3df;
+    i &= w;
+    i ^= i >> 5;
+  } while (i >= length);
+  return (i + seed) % length;
+}
+
+// Inverso radical na base dada (sequência de Halton) com embaralhamento de
+// Owen: cada dígito é permutado conforme os dígitos que o precedem
+double scrambledRadicalInverse(uint32_t index, uint32_t base, uint32_t seed) {
+  double invBase = 1.0 / base, factor = invBase, result = 0.0;
+  uint32_t prefix = seed;
+  // Dígitos além do índice também são permutados (zeros à esquerda)
+  while (factor > 1e-10) {
+    uint32_t digit = index % base;
+    index /= base;
+    result += permuteIndex(digit, base, prefix) * factor;
+    prefix = hashCombine(prefix, digit);
+    factor *= invBase;
+  }
+  return std::min(result, 1.0 - 1e-12);
+}
+
+const uint32_t HALTON_PRIMES[] = {
+    2,   3,   5,   7,   11,  13,  17,  19,  23,  29,  31,  37,  41,
+    43,  47,  53,  59,  61,  67,  71,  73,  79,  83,  89,  97,  101,
+    103, 107, 109, 113, 127, 131, 137, 139, 149, 151, 157, 163, 167,
+    173, 179, 181, 191, 193, 197, 199, 211, 223, 227, 229, 233, 239};
+const int HALTON_DIMENSIONS = sizeof(HALTON_PRIMES) / sizeof(HALTON_PRIMES[0]);
+
+// Amostrador: gera a amostra de índice sampleIndex de um pixel, uma dimensão
+// por vez. Todas as variantes são determinísticas dado (seed, pixel, índice),
+// então podem ser usadas por várias threads sem estado compartilhado.
+struct Sampler {
+  SamplerType type;
+  int samplesPerPixel;
+  uint32_t seed;
+
+  uint32_t pixelSeed;
+  uint32_t sampleIndex;
+  int dimension; // Próxima dimensão a ser consumida
+
+  Sampler(SamplerType type, int samplesPerPixel, uint32_t seed)
+      : type(type), samplesPerPixel(samplesPerPixel), seed(seed), pixelSeed(0),
+        sampleIndex(0), dimension(0) {}
+
+  void startPixelSample(int x, int y, int index) {
+    pixelSeed = hashCombine(hashCombine(seed, x), y);
+    sampleIndex = index;
+    dimension = 0;
+  }
+
+  void setDimension(int dim) { dimension = dim; }
+
+  double get1D() {
+    int dim = dimension++;
+    uint32_t dimSeed = hashCombine(pixelSeed, dim);
+
+    if (type == SAMPLER_STRATIFIED) {
+      uint32_t n = samplesPerPixel;
+      uint32_t stratum = permuteIndex(sampleIndex % n, n, dimSeed);
+      double jitter = toUnit(hashCombine(dimSeed, sampleIndex));
+      return (stratum + jitter) / n;
+    } else if (type == SAMPLER_HALTON && dim < HALTON_DIMENSIONS) {
+      return scrambledRadicalInverse(sampleIndex, HALTON_PRIMES[dim], dimSeed);
+    } else if (type == SAMPLER_SOBOL) {
+      uint32_t index = nestedUniformScramble(sampleIndex, dimSeed);
+      return toUnit(nestedUniformScramble(reverseBits(index),
+                                          hashCombine(dimSeed, 1)));
+    }
+
+    // Ruído branco (também usado além das dimensões de Halton)
+    return toUnit(hashCombine(dimSeed, hashUint(sampleIndex)));
+  }
+
+  void get2D(double &u, double &v) {
+    int dim = dimension;
+    uint32_t dimSeed = hashCombine(pixelSeed, dim);
+
+    if (type == SAMPLER_STRATIFIED) {
+      // Multi-jittered correlacionado (Kensler 2013) em grade m x n
+      uint32_t count = samplesPerPixel;
+      uint32_t m = (uint32_t)std::max(1.0, floor(sqrt((double)count)));
+      uint32_t n = (count + m - 1) / m;
+      uint32_t s = permuteIndex(sampleIndex % count, count, dimSeed);
+      uint32_t sx = permuteIndex(s % m, m, dimSeed * 0xa511e9b3);
+      uint32_t sy = permuteIndex(s / m, n, dimSeed * 0x63d83595);
+      double jx = toUnit(hashCombine(dimSeed * 0xa399d265, s));
+      double jy = toUnit(hashCombine(dimSeed * 0x711ad6a5, s));
+      u = (s % m + (sy + jx) / n) / m;
+      v = (s / m + (sx + jy) / m) / n;
+      dimension += 2;
+      return;
+    } else if (type == SAMPLER_SOBOL) {
+      // Sobol (0,2) embaralhado, com índice embaralhado por dimensão
+      uint32_t index = nestedUniformScramble(sampleIndex, dimSeed);
+      u = toUnit(nestedUniformScramble(reverseBits(index),
+                                       hashCombine(dimSeed, 1)));
+      v = toUnit(nestedUniformScramble(sobolDimension1(index),
+                                       hashCombine(dimSeed, 2)));
+      dimension += 2;
+      return;
+    }
+
+    u = get1D();
+    v = get1D();
+  }
+};
+
+// Converte o nome do amostrador da linha de comando
+bool parseSamplerType(const std::string &name, SamplerType &type) {
+  if (name == "random")
+    type = SAMPLER_RANDOM;
+  else if (name == "stratified")
+    type = SAMPLER_STRATIFIED;
+  else if (name == "halton")
+    type = SAMPLER_HALTON;
+  else if (name == "sobol")
+    type = SAMPLER_SOBOL;
+  else
+    return false;
+  return true;
+}
+
+// Mapeia o quadrado unitário no disco unitário preservando a estratificação
+// (mapeamento concêntrico de Shirley e Chiu)
+void concentricSampleDisk(double u, double v, double &dx, double &dy) {
+  double ox = 2.0 * u - 1.0;
+  double oy = 2.0 * v - 1.0;
+  if (ox == 0 && oy == 0) {
+    dx = dy = 0;
+    return;
+  }
+
+  double r, theta;
+  if (fabs(ox) > fabs(oy)) {
+    r = ox;
+    theta = (M_PI / 4.0) * (oy / ox);
+  } else {
+    r = oy;
+    theta = (M_PI / 2.0) - (M_PI / 4.0) * (ox / oy);
+  }
+  dx = r * cos(theta);
+  dy = r * sin(theta);
+}
+
+#endif
@@ -0,0 +1,353 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "cache.h"
+#include "loader.h"
+#include "optimize.h"
+#include "render.h"
+#include "structures.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Trabalho de renderização recebido pelo servidor
+struct RenderJob {
+  std::string scenePath;
+  std::string outputPath;
+  RenderSettings settings;
+};
+
+// Estado persistente do servidor: cenas e texturas já carregadas
+struct RenderServer {
+  LRUCache<std::string, std::shared_ptr<const Scene>> scenes;
+  TextureCache textures;
+
+  RenderServer(size_t sceneCapacity, size_t textureCapacity)
+      : scenes(sceneCapacity), textures(textureCapacity) {}
+};
+
+// Lê um trabalho no formato (campos opcionais como na linha de comando):
+// <cena.in> <saída.ppm> [largura] [altura] [abertura] [dist_focal] [amostras]
+bool parseRenderJob(const std::string &line, RenderJob &job,
+                    std::string &error) {
+  std::istringstream in(line);
+  if (!(in >> job.scenePath >> job.outputPath)) {
+    error = "trabalho incompleto";
+    return false;
+  }
+
+  // Lê em temporários: uma leitura falha zeraria o valor padrão
+  RenderSettings &s = job.settings;
+  int width, height, samples;
+  double aperture, focusDist;
+  if (in >> width) {
+    if (width <= 0) {
+      error = "largura inválida";
+      return false;
+    }
+    s.width = width;
+  }
+  if (in >> height) {
+    if (height <= 0) {
+      error = "altura inválida";
+      return false;
+    }
+    s.height = height;
+  }
+  if (in >> aperture) {
+    if (aperture < 0) {
+      error = "abertura inválida";
+      return false;
+    }
+    s.aperture = aperture;
+  }
+  if (in >> focusDist) {
+    if (focusDist <= 0) {
+      error = "distância focal inválida";
+      return false;
+    }
+    s.focusDist = focusDist;
+  }
+  if (in >> samples) {
+    if (samples <= 0) {
+      error = "número de amostras inválido";
+      return false;
+    }
+    s.samples = samples;
+  }
+  return true;
+}
+
+// Verifica se a malha de um objeto (ou de seus filhos CSG) mudou no disco
+bool meshChanged(const Object &obj) {
+  if (obj.type == MESH && obj.mesh &&
+      obj.mesh->key != fileCacheKey(obj.mesh->path))
+    return true;
+  for (const Object &child : obj.csgChildren)
+    if (meshChanged(child))
+      return true;
+  return false;
+}
+
+// Verifica se alguma textura ou malha usada pela cena mudou no disco (a
+// chave da cena só cobre o próprio arquivo .in)
+bool sceneFilesChanged(const Scene &scene) {
+  for (const Pigment &pigment : scene.pigments) {
+    if (pigment.type != TEXMAP)
+      continue;
+    // Textura ausente na carga: só recarrega se o arquivo passou a existir
+    if (!pigment.texture) {
+      std::error_code ec;
+      if (std::filesystem::exists(pigment.texturePath, ec))
+        return true;
+    } else if (pigment.texture->key != fileCacheKey(pigment.texturePath)) {
+      return true;
+    }
+  }
+  for (const Object &obj : scene.objects)
+    if (meshChanged(obj))
+      return true;
+  for (const Object &obj : scene.prototypes)
+    if (meshChanged(obj))
+      return true;
+  return false;
+}
+
+// Busca a cena no cache, carregando-a se ausente ou se ela, suas texturas ou
+// suas malhas foram modificadas
+std::shared_ptr<const Scene> getScene(RenderServer &server,
+                                      const std::string &path) {
+  std::string key = fileCacheKey(path);
+  std::shared_ptr<const Scene> scene;
+  if (server.scenes.get(key, scene) && !sceneFilesChanged(*scene))
+    return scene;
+
+  auto loaded = std::make_shared<Scene>();
+  if (!loadScene(path, *loaded, &server.textures))
+    return nullptr;
+
+  // A abertura muda a cada trabalho: só as regras que não dependem do olho
+  OptimizeOptions options;
+  options.removeUnreachable = false;
+  options.lensRadius = std::numeric_limits<double>::infinity();
+  optimizeScene(*loaded, options);
+
+  server.scenes.put(key, loaded);
+  return loaded;
+}
+
+// Executa um trabalho e devolve a resposta ("ok <saída>" ou "erro <motivo>")
+std::string runRenderJob(RenderServer &server, const std::string &line) {
+  RenderJob job;
+  std::string error;
+  if (!parseRenderJob(line, job, error))
+    return "erro " + error;
+
+  std::shared_ptr<const Scene> scene = getScene(server, job.scenePath);
+  if (!scene)
+    return "erro falha ao carregar a cena " + job.scenePath;
+
+  // Todas as threads do OpenMP são compartilhadas entre os trabalhos
+  std::vector<unsigned char> frameBuffer;
+  renderScene(*scene, job.settings, frameBuffer);
+  if (!savePPM(job.outputPath, frameBuffer, job.settings.width,
+               job.settings.height))
+    return "erro falha ao salvar " + job.outputPath;
+
+  return "ok " + job.outputPath;
+}
+
+// Trata uma linha de entrada. Retorna false quando o servidor deve encerrar.
+bool handleServerLine(RenderServer &server, const std::string &line,
+                      std::string &response) {
+  size_t start = line.find_first_not_of(" \t\r");
+  if (start == std::string::npos || line[start] == '#') {
+    response.clear();
+    return true;
+  }
+  size_t end = line.find_first_of(" \t\r", start);
+  if (line.compare(start, end == std::string::npos ? end : end - start,
+                   "quit") == 0) {
+    response = "ok";
+    return false;
+  }
+  response = runRenderJob(server, line);
+  return true;
+}
+
+// Atende trabalhos de um fluxo (uma linha por trabalho)
+void serveStream(RenderServer &server, std::istream &in, std::ostream &out) {
+  std::string line, response;
+  while (std::getline(in, line)) {
+    bool keepRunning = handleServerLine(server, line, response);
+    if (!response.empty())
+      out << response << std::endl;
+    if (!keepRunning)
+      break;
+  }
+}
+
+// Conexão aberta com o servidor e o trecho de linha ainda incompleto
+struct ServerClient {
+  int fd;
+  std::string pending;
+};
+
+// Envia a resposta inteira. MSG_NOSIGNAL: um cliente que já fechou a conexão
+// devolve EPIPE em vez de encerrar o servidor com SIGPIPE.
+bool sendResponse(int fd, const std::string &response) {
+  size_t sent = 0;
+  while (sent < response.size()) {
+    ssize_t n = send(fd, response.data() + sent, response.size() - sent,
+                     MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    sent += n;
+  }
+  return true;
+}
+
+// Aceita as conexões pendentes (o socket de escuta não bloqueia). Retorna
+// false em erro irrecuperável.
+bool acceptClients(int listenFd, const std::string &path,
+                   std::vector<ServerClient> &clients) {
+  while (true) {
+    int clientFd = accept(listenFd, nullptr, nullptr);
+    if (clientFd >= 0) {
+      clients.push_back({clientFd, std::string()});
+      continue;
+    }
+    // Nada mais na fila, ou conexão abortada pelo cliente antes do accept
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED)
+      return true;
+    if (errno == EINTR)
+      continue;
+    // Falta de descritores ou memória: espera recursos serem liberados
+    if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS ||
+        errno == ENOMEM) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      return true;
+    }
+    std::cerr << "Erro: Falha ao aceitar conexão em " << path << ": "
+              << std::strerror(errno) << std::endl;
+    return false;
+  }
+}
+
+// Atende trabalhos por um socket de domínio Unix. Várias conexões ficam
+// abertas ao mesmo tempo: a cada rodada o servidor executa no máximo um
+// trabalho de cada cliente com uma linha completa, de forma que uma conexão
+// ociosa ou com muitos trabalhos na fila não bloqueia as demais. Um cliente
+// que fecha a conexão antes da resposta é apenas descartado.
+bool serveUnixSocket(RenderServer &server, const std::string &path) {
+  int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    std::cerr << "Erro: Não foi possível criar o socket" << std::endl;
+    return false;
+  }
+
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Erro: Caminho do socket muito longo " << path << std::endl;
+    close(listenFd);
+    return false;
+  }
+  path.copy(addr.sun_path, path.size());
+
+  unlink(path.c_str());
+  if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listenFd, 8) < 0 ||
+      fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK) < 0) {
+    std::cerr << "Erro: Não foi possível escutar em " << path << std::endl;
+    close(listenFd);
+    return false;
+  }
+
+  std::vector<ServerClient> clients;
+  bool running = true, ok = true;
+  while (running) {
+    // Com trabalhos já recebidos, só verifica o que chegou, sem esperar
+    bool queued = false;
+    for (const ServerClient &client : clients)
+      queued = queued || client.pending.find('\n') != std::string::npos;
+
+    std::vector<pollfd> fds(clients.size() + 1);
+    fds[0] = {listenFd, POLLIN, 0};
+    for (size_t i = 0; i < clients.size(); i++)
+      fds[i + 1] = {clients[i].fd, POLLIN, 0};
+    if (poll(fds.data(), fds.size(), queued ? 0 : -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      std::cerr << "Erro: Falha ao esperar conexões em " << path << ": "
+                << std::strerror(errno) << std::endl;
+      ok = false;
+      break;
+    }
+
+    // Lê o que chegou; clientes que fecharam a conexão saem da lista (um
+    // trecho final sem quebra de linha é descartado)
+    std::vector<bool> closed(clients.size(), false);
+    for (size_t i = 0; i < clients.size(); i++) {
+      if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+      char buffer[4096];
+      ssize_t n = read(clients[i].fd, buffer, sizeof(buffer));
+      if (n > 0)
+        clients[i].pending.append(buffer, n);
+      else if (n == 0 || errno != EINTR)
+        closed[i] = clients[i].pending.find('\n') == std::string::npos;
+    }
+
+    // Um trabalho por cliente nesta rodada
+    for (size_t i = 0; i < clients.size() && running; i++) {
+      std::string &pending = clients[i].pending;
+      size_t newline = pending.find('\n');
+      if (newline == std::string::npos)
+        continue;
+      std::string line = pending.substr(0, newline);
+      pending.erase(0, newline + 1);
+
+      std::string response;
+      running = handleServerLine(server, line, response);
+      if (!response.empty() && !sendResponse(clients[i].fd, response + "\n"))
+        closed[i] = true;
+    }
+
+    for (size_t i = clients.size(); i-- > 0;) {
+      if (closed[i]) {
+        close(clients[i].fd);
+        clients.erase(clients.begin() + i);
+      }
+    }
+
+    if (running && (fds[0].revents & POLLIN) &&
+        !acceptClients(listenFd, path, clients)) {
+      ok = false;
+      break;
+    }
+  }
+
+  for (const ServerClient &client : clients)
+    close(client.fd);
+  close(listenFd);
+  unlink(path.c_str());
+  return ok;
+}
+
+#endif
@@ -2,14 +2,74 @@
 #define SHADING_H
 
 #include "intersect.h"
+#include "irradiance.h"
+#include "lights.h"
+#include "material.h"
 #include "pigment.h"
+#include "reach.h"
+#include "sampler.h"
+#include "shadowmap.h"
+#include "shadows.h"
 #include "structures.h"
 #include <algorithm>
-#include <cstdlib> // Para a função rand()
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <utility>
 
 const int MAX_DEPTH = 5; // Profundidade máxima de recursão
 
-Vec3 traceRay(const Ray &ray, const Scene &scene, int depth);
+// Opções de iluminação usadas durante o sombreamento
+struct ShadingOptions {
+  int lightSamples;  // Luzes amostradas por ponto (0 = todas)
+  double lensRadius; // Abertura da câmera (limita o descarte de oclusores)
+
+  // Se não nulo, recebe os objetos e as células tocados pelos raios do bloco
+  // (renderização incremental)
+  TileRecord *record;
+  const ReachGrid *reachGrid;
+
+  // Se não nulo, conta os raios traçados: primários, secundários e de
+  // sombra (renderPixels acumula por bloco e soma ao total no fim)
+  uint64_t *rayCount;
+
+  // Se não nulo, hits difusos cobertos pelo cache usam a visibilidade
+  // interpolada das luzes em vez de raios de sombra (só com todas as luzes)
+  const IrradianceCache *irradiance;
+
+  // Se não nulo, a visibilidade das luzes vem dos mapas de sombra, sem
+  // raios de sombra (modo de rascunho)
+  const ShadowMaps *shadowMaps;
+
+  ShadingOptions()
+      : lightSamples(DEFAULT_LIGHT_SAMPLES), lensRadius(0.0), record(nullptr),
+        reachGrid(nullptr), rayCount(nullptr), irradiance(nullptr),
+        shadowMaps(nullptr) {}
+};
+
+Vec3 traceRay(const Ray &ray, const Scene &scene, int depth,
+              Sampler &sampler, const ShadingOptions &options);
+
+// Com poucas luzes todas são avaliadas; com muitas, apenas lightSamples
+// são sorteadas pela hierarquia de luzes
+bool sampleAllLights(const Scene &scene, const ShadingOptions &options) {
+  return options.lightSamples <= 0 ||
+         (int)scene.lights.size() - 1 <= options.lightSamples;
+}
+
+// Dimensões do amostrador usadas pela iluminação direta de um rebote:
+// 3 por luz (sombra suave), ou 4 por luz sorteada (escolha + sombra)
+int lightDimensions(const Scene &scene, const ShadingOptions &options) {
+  if (sampleAllLights(scene, options))
+    return 3 * (int)scene.lights.size();
+  return 4 * options.lightSamples;
+}
+
+// Dimensões do amostrador usadas por rebote: iluminação direta, 3 para a
+// reflexão glossy e 3 para a refração glossy
+int bounceDimensions(const Scene &scene, const ShadingOptions &options) {
+  return lightDimensions(scene, options) + 6;
+}
 
 // Calcula o raio refletido
 Ray reflect(const Ray &ray, const Vec3 &point, const Vec3 &normal) {
@@ -49,88 +109,199 @@ bool refract(const Ray &ray, const Vec3 &normal, double ior, Vec3 &refracted) {
   return true;
 }
 
-// Calcula a cor de um ponto usando o modelo de iluminação Phong
-Vec3 shade(const HitInfo &hit, const Scene &scene, const Ray &ray, int depth) {
-  const Object &obj = scene.objects[hit.objectIdx];
-  const Pigment &pigment = scene.pigments[obj.pigmentIdx];
-  const Finish &finish = scene.finishes[obj.finishIdx];
+// Origem dos testes de sombra: o hit afastado da superfície pela normal
+Vec3 shadowRayOrigin(const HitInfo &hit, const Light &light) {
+  Vec3 lightDir = (light.position - hit.point).normalize();
 
-  // Obtém a cor base do pigmento
-  Vec3 baseColor = getPigmentColor(pigment, hit.point);
+  // Raio sombra com offset baseado no ângulo
+  double bias = 0.001;
+  double cosAngle = fabs(hit.normal.dot(lightDir));
 
-  // Componente ambiente (primeira luz fornece a cor ambiente)
-  Vec3 color = baseColor * scene.lights[0].color * finish.ka;
+  // Aumenta bias para ângulos rasantes
+  if (cosAngle < 0.1)
+    bias = 0.01;
 
-  // Itera por todas as luzes para componentes difusa e especular
-  for (size_t i = 1; i < scene.lights.size(); i++) {
-    const Light &light = scene.lights[i];
+  return hit.point + hit.normal * bias;
+}
 
-    Vec3 lightDir = (light.position - hit.point).normalize();
-    double lightDist = (light.position - hit.point).length();
+// Traça o raio de sombra do hit até samplePos, um ponto no cubo da luz.
+// Se occluderDist não for nulo, recebe a distância do oclusor encontrado.
+bool lightVisible(const HitInfo &hit, const Scene &scene, int lightIdx,
+                  const Vec3 &samplePos, const ShadingOptions &options,
+                  double *occluderDist = nullptr) {
+  Vec3 shadowOrigin = shadowRayOrigin(hit, scene.lights[lightIdx]);
+  Vec3 shadowLightDir = (samplePos - shadowOrigin).normalize();
+  double shadowLightDist = (samplePos - shadowOrigin).length();
+
+  Ray shadowRay(shadowOrigin, shadowLightDir);
+  // Só os possíveis oclusores desta luz são testados
+  const BVH &casters = shadowBVH(scene, lightIdx, hit.objectIdx,
+                                 &shadowOrigin, options.lensRadius);
+  // Qualquer oclusor antes da luz basta (o mais próximo só se a distância
+  // for pedida), e o hit não precisa ser finalizado
+  HitCandidate occluder;
+  if (options.rayCount)
+    ++*options.rayCount;
+  bool occluded = findOccluder(shadowRay, scene, casters,
+                               shadowLightDist - 1e-4, occluderDist != nullptr,
+                               occluder);
+  if (options.record)
+    options.record->addSegment(*options.reachGrid, shadowRay,
+                               occluded ? occluder.t : shadowLightDist);
+  if (occluded && occluderDist)
+    *occluderDist = occluder.t;
+  return !occluded;
+}
 
-    // Raio sombra com offset baseado no ângulo
-    double bias = 0.001;
-    double cosAngle = fabs(hit.normal.dot(lightDir));
+// Contribuição difusa e especular de uma luz sem considerar sombras.
+// Termos desligados pelos parâmetros do template não são calculados.
+template <bool Diffuse, bool Specular>
+Vec3 lightShading(const HitInfo &hit, const Ray &ray, const Light &light,
+                  const Vec3 &baseColor, const Finish &finish) {
+  Vec3 lightDir = (light.position - hit.point).normalize();
+  double lightDist = (light.position - hit.point).length();
 
-    // Aumenta bias para ângulos rasantes
-    if (cosAngle < 0.1)
-      bias = 0.01;
+  // Atenuação da luz
+  double denominator = light.attenuation.x + light.attenuation.y * lightDist +
+                       light.attenuation.z * lightDist * lightDist;
 
-    Vec3 shadowOrigin = hit.point + hit.normal * bias;
+  double attenuation = 1.0 / denominator;
 
-    // Sombras suaves via amostragem de área de luz
-    double lightRadius = 0.5;
+  Vec3 color(0, 0, 0);
 
-    // Amostra aleatória única
-    double r1 = ((double)rand() / RAND_MAX) * 2.0 - 1.0;
-    double r2 = ((double)rand() / RAND_MAX) * 2.0 - 1.0;
-    double r3 = ((double)rand() / RAND_MAX) * 2.0 - 1.0;
-    Vec3 offset(r1, r2, r3);
+  // Componente difusa
+  if constexpr (Diffuse) {
+    double diff = std::max(0.0, hit.normal.dot(lightDir));
+    color = baseColor * light.color * finish.kd * diff * attenuation;
+  }
 
-    Vec3 samplePos = light.position + offset * lightRadius;
-    Vec3 shadowLightDir = (samplePos - shadowOrigin).normalize();
-    double shadowLightDist = (samplePos - shadowOrigin).length();
+  // Componente especular
+  if constexpr (Specular) {
+    Vec3 viewDir = (ray.origin - hit.point).normalize();
+    Vec3 halfVec = (lightDir + viewDir).normalize();
+    double spec = pow(std::max(0.0, hit.normal.dot(halfVec)), finish.alpha);
+    color = color + light.color * finish.ks * spec * attenuation;
+  }
+  return color;
+}
 
-    Ray shadowRay(shadowOrigin, shadowLightDir);
-    HitInfo shadowHit = findClosestHit(shadowRay, scene);
+// Contribuição de uma luz com um raio de sombra para um ponto sorteado no
+// cubo da luz (as 3 dimensões seguintes do amostrador)
+template <bool Diffuse, bool Specular>
+Vec3 directLight(const HitInfo &hit, const Scene &scene, const Ray &ray,
+                 int lightIdx, const Vec3 &baseColor, const Finish &finish,
+                 Sampler &sampler, const ShadingOptions &options) {
+  const Light &light = scene.lights[lightIdx];
+
+  // Modo de rascunho: a penumbra vem do filtro do mapa de sombra
+  if (options.shadowMaps) {
+    double visibility = shadowMapVisibility(*options.shadowMaps, lightIdx,
+                                            light.position,
+                                            shadowRayOrigin(hit, light));
+    if (visibility <= 0.0)
+      return Vec3(0, 0, 0);
+    return lightShading<Diffuse, Specular>(hit, ray, light, baseColor,
+                                           finish) *
+           visibility;
+  }
 
-    bool inShadow = shadowHit.hit && shadowHit.t < shadowLightDist - 1e-4;
+  // Sombras suaves via amostragem de área de luz (amostra única)
+  double r1, r2;
+  sampler.get2D(r1, r2);
+  double r3 = sampler.get1D();
+  Vec3 offset(r1 * 2.0 - 1.0, r2 * 2.0 - 1.0, r3 * 2.0 - 1.0);
 
-    if (!inShadow) {
-      // Não está em sombra, logo, recebe luz difusa e especular
+  Vec3 samplePos = light.position + offset * LIGHT_RADIUS;
+  if (!lightVisible(hit, scene, lightIdx, samplePos, options))
+    return Vec3(0, 0, 0);
+
+  // Não está em sombra, logo, recebe luz difusa e especular
+  return lightShading<Diffuse, Specular>(hit, ray, light, baseColor, finish);
+}
 
-      // Atenuação da luz
-      double denominator = light.attenuation.x +
-                           light.attenuation.y * lightDist +
-                           light.attenuation.z * lightDist * lightDist;
+// Calcula a cor de um ponto usando o modelo de iluminação Phong. Cada
+// combinação de tipo de pigmento e recursos do acabamento (MATERIAL_*) gera
+// um núcleo próprio, sem os testes e termos que o material não usa.
+template <PigmentType Type, int Flags>
+Vec3 shadeKernel(const HitInfo &hit, const Scene &scene, const Ray &ray,
+                 int depth, Sampler &sampler, const ShadingOptions &options) {
+  constexpr bool diffuse = (Flags & MATERIAL_DIFFUSE) != 0;
+  constexpr bool specular = (Flags & MATERIAL_SPECULAR) != 0;
+  constexpr bool reflective = (Flags & MATERIAL_REFLECT) != 0;
+  constexpr bool refractive = (Flags & MATERIAL_REFRACT) != 0;
+
+  const SceneItem &obj = sceneItem(scene, hit.objectIdx);
+  const Pigment &pigment = scene.pigments[obj.pigmentIdx];
+  const Finish &finish = scene.finishes[obj.finishIdx];
 
-      double attenuation = 1.0 / denominator;
+  // Obtém a cor base do pigmento
+  Vec3 baseColor = pigmentColor<Type>(pigment, hit.point);
 
-      // Componente difusa
-      double diff = std::max(0.0, hit.normal.dot(lightDir));
-      Vec3 diffuse = baseColor * light.color * finish.kd * diff * attenuation;
+  // Componente ambiente (primeira luz fornece a cor ambiente)
+  Vec3 color = baseColor * scene.lights[0].color * finish.ka;
 
-      // Componente especular
-      Vec3 viewDir = (ray.origin - hit.point).normalize();
-      Vec3 halfVec = (lightDir + viewDir).normalize();
-      double spec = pow(std::max(0.0, hit.normal.dot(halfVec)), finish.alpha);
-      Vec3 specular = light.color * finish.ks * spec * attenuation;
-      color = color + diffuse + specular;
+  // Dimensões do amostrador reservadas para este rebote
+  int baseDim = SAMPLE_DIM_BOUNCE + depth * bounceDimensions(scene, options);
+  int reflectDim = baseDim + lightDimensions(scene, options);
+  int refractDim = reflectDim + 3;
+
+  // Sem difusa nem especular, as luzes (e seus raios de sombra) não
+  // contribuem
+  if constexpr (diffuse || specular) {
+    if (sampleAllLights(scene, options)) {
+      // Em hits difusos, as luzes interpoladas pelo cache dispensam os
+      // raios de sombra; as demais (bordas de sombra) são amostradas
+      float visibility[IRRADIANCE_MAX_LIGHTS];
+      bool cached = diffuse && options.irradiance &&
+                    lookupIrradiance(*options.irradiance, hit.point,
+                                     hit.normal, hit.objectIdx, visibility);
+
+      // Itera por todas as luzes para componentes difusa e especular
+      for (size_t i = 1; i < scene.lights.size(); i++) {
+        if (cached && visibility[i - 1] >= 0) {
+          if (visibility[i - 1] > 0)
+            color = color + lightShading<diffuse, specular>(
+                                hit, ray, scene.lights[i], baseColor,
+                                finish) *
+                                visibility[i - 1];
+          continue;
+        }
+        sampler.setDimension(baseDim + 3 * (int)i);
+        color = color + directLight<diffuse, specular>(
+                            hit, scene, ray, (int)i, baseColor, finish,
+                            sampler, options);
+      }
+    } else {
+      // Sorteia lightSamples luzes proporcionalmente à contribuição
+      // estimada e divide cada uma pela sua probabilidade. O estimador só é
+      // sem viés se a cor não for limitada antes da média das amostras do
+      // pixel (ver o fim da função)
+      for (int k = 0; k < options.lightSamples; k++) {
+        sampler.setDimension(baseDim + 4 * k);
+        double pdf;
+        int i = sampleLightTree(scene, hit.point, sampler.get1D(), pdf);
+        if (i < 0)
+          continue;
+        Vec3 contribution = directLight<diffuse, specular>(
+            hit, scene, ray, i, baseColor, finish, sampler, options);
+        color = color + contribution / (pdf * options.lightSamples);
+      }
     }
   }
 
   // Reflexão
-  if (finish.kr > 0 && depth < MAX_DEPTH) {
+  if (reflective && depth < MAX_DEPTH) {
     Ray reflectedRay = reflect(ray, hit.point, hit.normal);
 
     // Reflexão glossy (Ray Tracing Distribuído)
     // Perturbação baseada na rugosidade (inverso do expoente especular)
     double roughness = (finish.alpha > 1e-3) ? (1.0 / finish.alpha) : 1.0;
 
-    double r1 = ((double)rand() / RAND_MAX) * 2.0 - 1.0;
-    double r2 = ((double)rand() / RAND_MAX) * 2.0 - 1.0;
-    double r3 = ((double)rand() / RAND_MAX) * 2.0 - 1.0;
-    Vec3 jitter(r1, r2, r3);
+    double r1, r2;
+    sampler.setDimension(reflectDim);
+    sampler.get2D(r1, r2);
+    double r3 = sampler.get1D();
+    Vec3 jitter(r1 * 2.0 - 1.0, r2 * 2.0 - 1.0, r3 * 2.0 - 1.0);
 
     Vec3 perturbedDir =
         (reflectedRay.direction + jitter * roughness).normalize();
@@ -142,12 +313,13 @@ Vec3 shade(const HitInfo &hit, const Scene &scene, const Ray &ray, int depth) {
 
     reflectedRay.direction = perturbedDir;
 
-    Vec3 reflectedColor = traceRay(reflectedRay, scene, depth + 1);
+    Vec3 reflectedColor =
+        traceRay(reflectedRay, scene, depth + 1, sampler, options);
     color = color + reflectedColor * finish.kr;
   }
 
   // Refração/Transmissão
-  if (finish.kt > 0 && depth < MAX_DEPTH) {
+  if (refractive && depth < MAX_DEPTH) {
     Vec3 refractedDir;
     if (refract(ray, hit.normal, finish.ior, refractedDir)) {
       // Offset na direção da refração
@@ -156,32 +328,76 @@ Vec3 shade(const HitInfo &hit, const Scene &scene, const Ray &ray, int depth) {
 
       // Refração glossy (Ray Tracing Distribuído)
       double roughness = (finish.alpha > 1e-3) ? (5.0 / finish.alpha) : 1.0;
-      double r1 = ((double)rand() / RAND_MAX) * 2.0 - 1.0;
-      double r2 = ((double)rand() / RAND_MAX) * 2.0 - 1.0;
-      double r3 = ((double)rand() / RAND_MAX) * 2.0 - 1.0;
-      Vec3 jitter(r1, r2, r3);
+      double r1, r2;
+      sampler.setDimension(refractDim);
+      sampler.get2D(r1, r2);
+      double r3 = sampler.get1D();
+      Vec3 jitter(r1 * 2.0 - 1.0, r2 * 2.0 - 1.0, r3 * 2.0 - 1.0);
 
       refractedRay.direction =
           (refractedRay.direction + jitter * roughness).normalize();
 
-      Vec3 refractedColor = traceRay(refractedRay, scene, depth + 1);
+      Vec3 refractedColor =
+          traceRay(refractedRay, scene, depth + 1, sampler, options);
       color = color + refractedColor * finish.kt;
     }
   }
 
-  return color.clamp();
+  // Com todas as luzes avaliadas, a cor de cada hit é limitada a [0, 1].
+  // Com luzes sorteadas, limitar aqui cortaria as amostras de pdf baixo e
+  // escureceria a imagem: o limite fica para a média do pixel.
+  if (sampleAllLights(scene, options))
+    return color.clamp();
+  return color;
+}
+
+typedef Vec3 (*ShadeKernel)(const HitInfo &, const Scene &, const Ray &, int,
+                            Sampler &, const ShadingOptions &);
+
+// Tabela com um núcleo por índice de material (ver materialKernel)
+template <int... Index>
+constexpr std::array<ShadeKernel, sizeof...(Index)>
+makeShadeKernels(std::integer_sequence<int, Index...>) {
+  return {{&shadeKernel<(PigmentType)(Index / MATERIAL_FLAG_COUNT),
+                        Index % MATERIAL_FLAG_COUNT>...}};
+}
+
+const std::array<ShadeKernel, SHADE_KERNEL_COUNT> SHADE_KERNELS =
+    makeShadeKernels(std::make_integer_sequence<int, SHADE_KERNEL_COUNT>());
+
+// Sombreia o hit com o núcleo do material do objeto
+Vec3 shade(const HitInfo &hit, const Scene &scene, const Ray &ray,
+           int depth, Sampler &sampler, const ShadingOptions &options) {
+  const SceneItem &obj = sceneItem(scene, hit.objectIdx);
+  int kernel = obj.material;
+  if (kernel < 0)
+    kernel = materialKernel(scene.pigments[obj.pigmentIdx],
+                            scene.finishes[obj.finishIdx]);
+  return SHADE_KERNELS[kernel](hit, scene, ray, depth, sampler, options);
 }
 
 // Traça um raio na cena
-Vec3 traceRay(const Ray &ray, const Scene &scene, int depth) {
+Vec3 traceRay(const Ray &ray, const Scene &scene, int depth,
+              Sampler &sampler, const ShadingOptions &options) {
   if (depth > MAX_DEPTH) {
     return Vec3(0, 0, 0);
   }
 
   HitInfo hit = findClosestHit(ray, scene);
+  if (options.rayCount)
+    ++*options.rayCount;
+
+  if (options.record) {
+    double reach = std::numeric_limits<double>::infinity();
+    if (hit.hit) {
+      reach = hit.t;
+      options.record->addObject(hit.objectIdx);
+    }
+    options.record->addSegment(*options.reachGrid, ray, reach);
+  }
 
   if (hit.hit) {
-    return shade(hit, scene, ray, depth);
+    return shade(hit, scene, ray, depth, sampler, options);
   }
 
   // Cor de fundo - preto, não encontrou nada
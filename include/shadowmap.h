@@ -0,0 +1,185 @@
+#ifndef SHADOWMAP_H
+#define SHADOWMAP_H
+
+#include "intersect.h"
+#include "lights.h"
+#include "shadows.h"
+#include "structures.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Mapas de sombra: para cada luz, um cube map com a distância do centro da
+// luz até o primeiro oclusor em cada direção. Substituem os raios de sombra
+// por consultas com filtragem (PCF), aproximando a penumbra das luzes de
+// área: modo de rascunho, mais rápido e menos exato.
+const int SHADOW_MAP_SEARCH = 3; // Amostras por eixo na busca de oclusores
+const int SHADOW_MAP_FILTER = 4; // Amostras por eixo do PCF
+const double SHADOW_MAP_MAX_RADIUS = 8.0; // Raio máximo do filtro (texels)
+const double SHADOW_MAP_BIAS = 1.5; // Tolerância de profundidade (texels)
+
+// Distâncias dos 6 lados de cada luz (índice 0, a ambiente, fica vazio).
+// O lado f olha para o eixo f / 2, no sentido positivo se f é par; cada
+// texel guarda a distância ao oclusor (infinito se não há nenhum).
+struct ShadowMaps {
+  int size; // Texels por aresta de cada lado
+  std::vector<std::vector<float>> depth;
+
+  ShadowMaps() : size(0) {}
+};
+
+// Direção do ponto (s, t) em [-1, 1]^2 do lado face (não normalizada);
+// fora do intervalo, aponta para os lados vizinhos
+Vec3 cubeDirection(int face, double s, double t) {
+  double c[3];
+  int axis = face / 2;
+  c[axis] = (face % 2 == 0) ? 1.0 : -1.0;
+  c[(axis + 1) % 3] = s;
+  c[(axis + 2) % 3] = t;
+  return Vec3(c[0], c[1], c[2]);
+}
+
+// Lado e coordenadas (s, t) atingidos pela direção d (inverso de
+// cubeDirection)
+int cubeFace(const Vec3 &d, double &s, double &t) {
+  double c[3] = {d.x, d.y, d.z};
+  int axis = 0;
+  if (fabs(c[1]) > fabs(c[axis]))
+    axis = 1;
+  if (fabs(c[2]) > fabs(c[axis]))
+    axis = 2;
+  double major = fabs(c[axis]);
+  s = c[(axis + 1) % 3] / major;
+  t = c[(axis + 2) % 3] / major;
+  return 2 * axis + (c[axis] < 0 ? 1 : 0);
+}
+
+// Distância guardada no texel mais próximo da direção d
+float cubeDepth(const ShadowMaps &maps, int light, const Vec3 &d) {
+  double s, t;
+  int face = cubeFace(d, s, t);
+  int n = maps.size;
+  int i = std::min(n - 1, std::max(0, (int)((s + 1.0) * 0.5 * n)));
+  int j = std::min(n - 1, std::max(0, (int)((t + 1.0) * 0.5 * n)));
+  return maps.depth[light][((size_t)face * n + j) * n + i];
+}
+
+// Traça os raios de todos os texels a partir do centro de cada luz, em
+// paralelo por linha de texels. Oclusores descartados para a luz (ver
+// shadowBVH, com o raio lensRadius em volta do olho) não entram, pois
+// nunca bloqueiam um raio de sombra. Se rayCount não for nulo, soma os
+// raios traçados.
+void buildShadowMaps(const Scene &scene, int size, double lensRadius,
+                     ShadowMaps &maps, uint64_t *rayCount = nullptr) {
+  maps.size = size;
+  maps.depth.assign(scene.lights.size(), std::vector<float>());
+  int lights = (int)scene.lights.size() - 1;
+  if (lights <= 0)
+    return;
+
+  std::vector<OriginCache> origins(scene.lights.size());
+  for (int l = 1; l <= lights; l++) {
+    maps.depth[l].resize((size_t)6 * size * size);
+    buildOriginCache(scene, scene.lights[l].position, origins[l]);
+  }
+
+  int rows = lights * 6 * size;
+#pragma omp parallel for schedule(dynamic)
+  for (int row = 0; row < rows; row++) {
+    int l = 1 + row / (6 * size);
+    int face = row / size % 6;
+    int j = row % size;
+    const Light &light = scene.lights[l];
+    const BVH &casters = shadowBVH(scene, l, -1, nullptr, lensRadius);
+    float *out = &maps.depth[l][((size_t)face * size + j) * size];
+    double t = (j + 0.5) * 2.0 / size - 1.0;
+    for (int i = 0; i < size; i++) {
+      double s = (i + 0.5) * 2.0 / size - 1.0;
+      Ray ray(light.position, cubeDirection(face, s, t));
+      HitCandidate occluder;
+      int occluderIdx;
+      out[i] = findClosestCandidate(ray, scene, casters, occluder,
+                                    occluderIdx, &origins[l])
+                   ? (float)occluder.t
+                   : std::numeric_limits<float>::infinity();
+    }
+    if (rayCount) {
+#pragma omp atomic
+      *rayCount += size;
+    }
+  }
+}
+
+// Fração visível da luz a partir de p, como nas sombras suaves por PCSS:
+// a busca ao redor da direção de p estima a distância média dos oclusores,
+// que dá a largura da penumbra (semelhança de triângulos com o cubo da
+// luz); o PCF compara então uma grade de texels nessa largura com a
+// distância de p.
+double shadowMapVisibility(const ShadowMaps &maps, int light,
+                           const Vec3 &lightPos, const Vec3 &p) {
+  Vec3 d = p - lightPos;
+  double dist = d.length();
+  double s, t;
+  int face = cubeFace(d, s, t);
+  int n = maps.size;
+  const float *depth = &maps.depth[light][(size_t)face * n * n];
+
+  // Posição em texels; deslocamentos que saem do lado são reprojetados
+  // no lado vizinho
+  double x = (s + 1.0) * 0.5 * n, y = (t + 1.0) * 0.5 * n;
+  auto fetch = [&](double dx, double dy) {
+    int i = (int)floor(x + dx), j = (int)floor(y + dy);
+    if (i >= 0 && i < n && j >= 0 && j < n)
+      return depth[(size_t)j * n + i];
+    return cubeDepth(maps, light,
+                     cubeDirection(face, (i + 0.5) * 2.0 / n - 1.0,
+                                   (j + 0.5) * 2.0 / n - 1.0));
+  };
+
+  // Tolerância proporcional ao tamanho do texel na distância de p
+  double texel = 2.0 / n; // Aresta do texel em (s, t)
+  double receiver = dist - (SHADOW_MAP_BIAS * texel * dist + 1e-3);
+
+  // Busca de oclusores no raio máximo do filtro
+  double blockerSum = 0.0;
+  int blockers = 0;
+  for (int b = 0; b < SHADOW_MAP_SEARCH; b++) {
+    for (int a = 0; a < SHADOW_MAP_SEARCH; a++) {
+      double da = (a + 0.5) / SHADOW_MAP_SEARCH * 2.0 - 1.0;
+      double db = (b + 0.5) / SHADOW_MAP_SEARCH * 2.0 - 1.0;
+      float z = fetch(da * SHADOW_MAP_MAX_RADIUS, db * SHADOW_MAP_MAX_RADIUS);
+      if (z < receiver) {
+        blockerSum += z;
+        blockers++;
+      }
+    }
+  }
+  // Nenhum oclusor ou só oclusores em volta: fora ou dentro da sombra,
+  // sem penumbra a filtrar
+  if (blockers == 0)
+    return 1.0;
+  if (blockers == SHADOW_MAP_SEARCH * SHADOW_MAP_SEARCH)
+    return 0.0;
+
+  // Largura da penumbra no receptor, levada ao plano do cube map (texels)
+  double blocker = blockerSum / blockers;
+  double penumbra =
+      2.0 * LIGHT_RADIUS * (dist - blocker) / (blocker * dist) / texel;
+  double radius =
+      std::min(SHADOW_MAP_MAX_RADIUS, std::max(0.5, 0.5 * penumbra));
+
+  int lit = 0;
+  for (int b = 0; b < SHADOW_MAP_FILTER; b++) {
+    for (int a = 0; a < SHADOW_MAP_FILTER; a++) {
+      double da = (a + 0.5) / SHADOW_MAP_FILTER * 2.0 - 1.0;
+      double db = (b + 0.5) / SHADOW_MAP_FILTER * 2.0 - 1.0;
+      if (fetch(da * radius, db * radius) >= receiver)
+        lit++;
+    }
+  }
+  return (double)lit / (SHADOW_MAP_FILTER * SHADOW_MAP_FILTER);
+}
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef SHADOWS_H
+#define SHADOWS_H
+
+#include "bvh.h"
+#include "lights.h"
+#include "structures.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <vector>
+
+// Distância de p até a borda de um objeto convexo, positiva se p está dentro
+// (-infinito para objetos que não são convexos)
+double convexClearance(const Object &obj, const Vec3 &p) {
+  if (obj.type == SPHERE)
+    return obj.radius - (p - obj.center).length();
+
+  if (obj.type == POLYHEDRON) {
+    double clearance = std::numeric_limits<double>::infinity();
+    for (const Plane &plane : obj.faces)
+      clearance = std::min(clearance, -plane.distance(p));
+    return clearance;
+  }
+  return -std::numeric_limits<double>::infinity();
+}
+
+// O objeto envolve o cubo de amostragem da luz? Basta testar os vértices,
+// pois o objeto é convexo.
+bool enclosesLight(const Object &obj, const Light &light) {
+  for (int corner = 0; corner < 8; corner++) {
+    Vec3 offset((corner & 1) ? LIGHT_RADIUS : -LIGHT_RADIUS,
+                (corner & 2) ? LIGHT_RADIUS : -LIGHT_RADIUS,
+                (corner & 4) ? LIGHT_RADIUS : -LIGHT_RADIUS);
+    if (convexClearance(obj, light.position + offset) <= 0)
+      return false;
+  }
+  return true;
+}
+
+const double SHADOW_MARGIN = 1e-3; // Folga das regiões usadas nos descartes
+
+// A caixa toca o fecho convexo de a e b? O fecho é a união das caixas
+// (1 - s) a + s b, s em [0, 1], e cada lado da sobreposição com box é uma
+// desigualdade linear em s: basta intersectar os intervalos de s.
+bool touchesHull(const AABB &box, const AABB &a, const AABB &b) {
+  double lo = 0.0, hi = 1.0;
+  // c0 + s c1 <= 0
+  auto limit = [&lo, &hi](double c0, double c1) {
+    if (c1 > 0)
+      hi = std::min(hi, -c0 / c1);
+    else if (c1 < 0)
+      lo = std::max(lo, -c0 / c1);
+    else if (c0 > 0)
+      hi = -1.0;
+  };
+  for (int axis = 0; axis < 3; axis++) {
+    auto at = [axis](const Vec3 &v) {
+      return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+    };
+    limit(at(a.min) - at(box.max), at(b.min) - at(a.min));
+    limit(at(box.min) - at(a.max), at(a.max) - at(b.max));
+  }
+  return lo <= hi;
+}
+
+// Recorta o polígono convexo poly pelo semiespaço (p - origin) . n <= margin
+std::vector<Vec3> clipPolygon(const std::vector<Vec3> &poly,
+                              const Vec3 &origin, const Vec3 &n,
+                              double margin) {
+  std::vector<Vec3> out;
+  for (size_t i = 0; i < poly.size(); i++) {
+    const Vec3 &a = poly[i], &b = poly[(i + 1) % poly.size()];
+    double da = (a - origin).dot(n) - margin;
+    double db = (b - origin).dot(n) - margin;
+    if (da <= 0)
+      out.push_back(a);
+    if ((da < 0 && db > 0) || (da > 0 && db < 0))
+      out.push_back(a + (b - a) * (da / (da - db)));
+  }
+  return out;
+}
+
+// Caixa da parte de box vista pela câmera da cena: à frente do olho e entre
+// os planos de cima e de baixo do campo de visão (a abertura horizontal
+// depende da resolução, que a cena não guarda). Todos os planos passam pelo
+// olho, então os vértices do recorte estão nas faces da caixa ou no olho.
+AABB visibleRegion(const Scene &scene, const AABB &box) {
+  Vec3 w = (scene.eye - scene.lookAt).normalize();
+  Vec3 u = scene.up.cross(w).normalize();
+  Vec3 v = scene.up.normalize();
+  double h = tan(scene.fovy * M_PI / 360.0);
+
+  // Normais para fora; a direção central (-w) fica do lado de dentro
+  std::vector<Vec3> normals = {w};
+  for (double side : {1.0, -1.0}) {
+    Vec3 n = u.cross(v * (side * h) - w).normalize();
+    normals.push_back(n.dot(w * -1.0) > 0 ? n * -1.0 : n);
+  }
+
+  AABB region;
+  if (box.contains(scene.eye))
+    region.expand(scene.eye);
+  for (int axis = 0; axis < 3; axis++) {
+    for (int side = 0; side < 2; side++) {
+      // Face da caixa com a coordenada axis fixa, vértices em ordem
+      std::vector<Vec3> face;
+      for (int k : {0, 1, 3, 2}) {
+        double c[3], lo[3] = {box.min.x, box.min.y, box.min.z},
+                     hi[3] = {box.max.x, box.max.y, box.max.z};
+        c[axis] = side ? hi[axis] : lo[axis];
+        c[(axis + 1) % 3] = (k & 1) ? hi[(axis + 1) % 3] : lo[(axis + 1) % 3];
+        c[(axis + 2) % 3] = (k & 2) ? hi[(axis + 2) % 3] : lo[(axis + 2) % 3];
+        face.push_back(Vec3(c[0], c[1], c[2]));
+      }
+      for (const Vec3 &n : normals)
+        face = clipPolygon(face, scene.eye, n, SHADOW_MARGIN);
+      for (const Vec3 &p : face)
+        region.expand(p);
+    }
+  }
+  return region;
+}
+
+// Constrói, para cada luz, a lista reduzida de possíveis oclusores, com
+// dois descartes:
+//
+// - Um objeto convexo opaco e sem reflexão que contém a luz e o olho nunca
+//   é atravessado por raios de sombra: todo raio traçado parte do olho ou
+//   de um hit dentro do objeto (nada continua a partir da sua superfície),
+//   e o segmento entre dois pontos internos de um convexo não cruza a
+//   borda. A exceção são os pontos na própria superfície do objeto.
+//
+// - Os raios de sombra que partem da região dos receptores (a parte vista
+//   pela câmera da caixa dos objetos limitados, sem os descartados acima)
+//   ficam no fecho convexo dessa região e do cubo da luz. Objetos cuja
+//   caixa não toca esse fecho (atrás da luz ou fora do volume entre os
+//   receptores e ela) não fazem sombra para esses raios.
+//
+// Origens fora dessas condições usam a BVH completa (ver shadowBVH). Luzes
+// com os mesmos descartes compartilham a BVH.
+void buildShadowCasters(Scene &scene) {
+  scene.shadowCasters.clear();
+  scene.lightCasters.assign(scene.lights.size(), -1);
+
+  int count = sceneItemCount(scene);
+  std::map<std::pair<std::vector<int>, std::vector<int>>, int> groups;
+  for (size_t i = 1; i < scene.lights.size(); i++) {
+    const Light &light = scene.lights[i];
+
+    std::vector<int> enclosing;
+    double eyeClearance = std::numeric_limits<double>::infinity();
+    for (size_t j = 0; j < scene.objects.size(); j++) {
+      const Object &obj = scene.objects[j];
+      const Finish &finish = scene.finishes[obj.finishIdx];
+      if (finish.kr > 0 || finish.kt > 0)
+        continue;
+      double clearance = convexClearance(obj, scene.eye);
+      if (clearance > 0 && enclosesLight(obj, light)) {
+        enclosing.push_back((int)j);
+        eyeClearance = std::min(eyeClearance, clearance);
+      }
+    }
+
+    AABB bounded;
+    for (int j = 0; j < count; j++) {
+      const AABB &box = sceneItem(scene, j).bounds;
+      if (!box.isEmpty() && !box.isInfinite() &&
+          !std::binary_search(enclosing.begin(), enclosing.end(), j))
+        bounded.expand(box);
+    }
+    AABB receivers = bounded.isEmpty() ? bounded : visibleRegion(scene, bounded);
+    Vec3 margin(SHADOW_MARGIN, SHADOW_MARGIN, SHADOW_MARGIN);
+    receivers.min = receivers.min - margin;
+    receivers.max = receivers.max + margin;
+    Vec3 r = margin + Vec3(LIGHT_RADIUS, LIGHT_RADIUS, LIGHT_RADIUS);
+    AABB cube;
+    cube.expand(light.position - r);
+    cube.expand(light.position + r);
+
+    std::vector<int> outside, kept;
+    for (int j = 0; j < count; j++) {
+      if (std::binary_search(enclosing.begin(), enclosing.end(), j))
+        continue;
+      const AABB &box = sceneItem(scene, j).bounds;
+      if (!receivers.isEmpty() && !box.isEmpty() && !box.isInfinite() &&
+          !touchesHull(box, cube, receivers))
+        outside.push_back(j);
+      else
+        kept.push_back(j);
+    }
+    if (enclosing.empty() && outside.empty())
+      continue;
+
+    auto key = std::make_pair(enclosing, outside);
+    auto found = groups.find(key);
+    if (found != groups.end()) {
+      scene.lightCasters[i] = found->second;
+      continue;
+    }
+
+    ShadowCasters casters;
+    casters.culled = enclosing;
+    casters.eyeClearance = eyeClearance;
+    casters.receivers = outside.empty() ? AABB::infinite() : receivers;
+    buildBVHOver(casters.bvh, scene, kept);
+
+    scene.lightCasters[i] = (int)scene.shadowCasters.size();
+    groups[key] = scene.lightCasters[i];
+    scene.shadowCasters.push_back(casters);
+  }
+}
+
+// BVH a ser usada pelos raios de sombra de uma luz que partem de origin, um
+// ponto do objeto receiver. lensRadius é o raio da abertura da câmera: o
+// olho se espalha pelo disco da lente, que precisa caber nos objetos
+// descartados. Sem origin (raios que não partem de um receptor, como os
+// dos mapas de sombra), só o primeiro descarte é válido: se houver
+// objetos descartados pelo fecho, usa a BVH completa.
+const BVH &shadowBVH(const Scene &scene, int light, int receiver,
+                     const Vec3 *origin, double lensRadius) {
+  int group = scene.lightCasters.empty() ? -1 : scene.lightCasters[light];
+  if (group < 0)
+    return scene.bvh;
+
+  const ShadowCasters &casters = scene.shadowCasters[group];
+  bool hullCulled = !casters.receivers.isInfinite();
+  if (lensRadius >= casters.eyeClearance ||
+      (hullCulled && (!origin || !casters.receivers.contains(*origin))) ||
+      std::binary_search(casters.culled.begin(), casters.culled.end(),
+                         receiver))
+    return scene.bvh;
+  return casters.bvh;
+}
+
+#endif
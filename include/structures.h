@@ -1,8 +1,12 @@
 #ifndef STRUCTURES_H
 #define STRUCTURES_H
 
+#include "transform.h"
 #include "vec3.h"
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -17,6 +21,101 @@ struct Ray {
   Vec3 at(double t) const { return origin + direction * t; }
 };
 
+// Caixa delimitadora alinhada aos eixos
+struct AABB {
+  Vec3 min, max;
+
+  // Caixa vazia por padrão
+  AABB()
+      : min(std::numeric_limits<double>::infinity(),
+            std::numeric_limits<double>::infinity(),
+            std::numeric_limits<double>::infinity()),
+        max(-std::numeric_limits<double>::infinity(),
+            -std::numeric_limits<double>::infinity(),
+            -std::numeric_limits<double>::infinity()) {}
+
+  static AABB infinite() {
+    AABB box;
+    std::swap(box.min, box.max);
+    return box;
+  }
+
+  bool isEmpty() const { return min.x > max.x; }
+
+  bool contains(const Vec3 &p) const {
+    return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y &&
+           p.z >= min.z && p.z <= max.z;
+  }
+
+  // A caixa vazia (min = +inf) não conta como infinita
+  bool isInfinite() const {
+    return !isEmpty() &&
+           (std::isinf(min.x) || std::isinf(min.y) || std::isinf(min.z) ||
+            std::isinf(max.x) || std::isinf(max.y) || std::isinf(max.z));
+  }
+
+  // Comparações diretas em vez de fmin/fmax, que viram chamadas à libm e
+  // dominavam a construção de BVHs grandes; NaN continua sendo ignorado
+  void expand(const Vec3 &p) {
+    if (p.x < min.x)
+      min.x = p.x;
+    if (p.y < min.y)
+      min.y = p.y;
+    if (p.z < min.z)
+      min.z = p.z;
+    if (p.x > max.x)
+      max.x = p.x;
+    if (p.y > max.y)
+      max.y = p.y;
+    if (p.z > max.z)
+      max.z = p.z;
+  }
+
+  void expand(const AABB &box) {
+    expand(box.min);
+    expand(box.max);
+  }
+
+  Vec3 center() const { return (min + max) * 0.5; }
+
+  double surfaceArea() const {
+    Vec3 d = max - min;
+    return 2.0 * (d.x * d.y + d.y * d.z + d.z * d.x);
+  }
+
+  // Teste de slab; invDir é o inverso componente a componente da direção
+  bool intersect(const Vec3 &origin, const Vec3 &invDir, double tMax,
+                 double &tEnter) const {
+    double t0 = 0.0, t1 = tMax;
+    // Comparações escritas para que NaN (0 * inf) não restrinja o intervalo
+    for (int axis = 0; axis < 3; axis++) {
+      double o = axis == 0 ? origin.x : (axis == 1 ? origin.y : origin.z);
+      double inv = axis == 0 ? invDir.x : (axis == 1 ? invDir.y : invDir.z);
+      double lo = axis == 0 ? min.x : (axis == 1 ? min.y : min.z);
+      double hi = axis == 0 ? max.x : (axis == 1 ? max.y : max.z);
+      double ta = (lo - o) * inv;
+      double tb = (hi - o) * inv;
+      if (ta > tb)
+        std::swap(ta, tb);
+      if (ta > t0)
+        t0 = ta;
+      if (tb < t1)
+        t1 = tb;
+    }
+    tEnter = t0;
+    return t0 <= t1;
+  }
+};
+
+// Textura decodificada (compartilhada entre pigmentos e cenas)
+struct Texture {
+  std::string key; // Arquivo e data de modificação
+  int width, height;
+  std::vector<Vec3> data;
+
+  Texture() : width(0), height(0) {}
+};
+
 // Tipos de pigmento
 enum PigmentType { SOLID, CHECKER, TEXMAP };
 
@@ -28,12 +127,9 @@ struct Pigment {
   // Para mapeamento de textura
   std::string texturePath;
   double p0[4], p1[4];
-  std::vector<Vec3> textureData;
-  int textureWidth, textureHeight;
+  std::shared_ptr<const Texture> texture;
 
-  Pigment()
-      : type(SOLID), color1(1, 1, 1), color2(0, 0, 0), scale(1.0),
-        textureWidth(0), textureHeight(0) {
+  Pigment() : type(SOLID), color1(1, 1, 1), color2(0, 0, 0), scale(1.0) {
     for (int i = 0; i < 4; i++)
       p0[i] = p1[i] = 0;
   }
@@ -78,21 +174,59 @@ struct Plane {
   }
 };
 
+const int POLY_LANES = 4; // Faces do poliedro testadas por bloco
+
+// Faces do poliedro em estrutura de arrays (SoA), completadas até um
+// múltiplo de POLY_LANES com planos neutros (0x + 0y + 0z - 1 = 0, sempre
+// satisfeitos), para que o recorte processe blocos inteiros sem desvios
+struct FaceArrays {
+  std::vector<double> a, b, c, d;
+
+  void assign(const std::vector<Plane> &faces) {
+    size_t count = (faces.size() + POLY_LANES - 1) / POLY_LANES * POLY_LANES;
+    a.assign(count, 0.0);
+    b.assign(count, 0.0);
+    c.assign(count, 0.0);
+    d.assign(count, -1.0);
+    for (size_t i = 0; i < faces.size(); i++) {
+      a[i] = faces[i].a;
+      b[i] = faces[i].b;
+      c[i] = faces[i].c;
+      d[i] = faces[i].d;
+    }
+  }
+};
+
 // Tipos de objeto
-enum ObjectType { SPHERE, POLYHEDRON, QUADRIC, CSG };
+enum ObjectType { SPHERE, POLYHEDRON, QUADRIC, CSG, INSTANCE, MESH };
 enum CSGOperation { CSG_UNION, CSG_DIFFERENCE };
 
-struct Object {
-  ObjectType type;
+struct Mesh;
+
+// Dados comuns a objetos e instâncias: material e caixa no espaço do mundo
+// (infinita se ilimitado)
+struct SceneItem {
   int pigmentIdx;
   int finishIdx;
+  int material; // Núcleo de sombreamento (ver material.h), -1 = não definido
+  AABB bounds;
+
+  SceneItem()
+      : pigmentIdx(0), finishIdx(0), material(-1), bounds(AABB::infinite()) {}
+};
+
+// Objeto com geometria própria. O tipo INSTANCE só marca, durante a leitura,
+// que a linha descrevia uma instância (ver Instance).
+struct Object : SceneItem {
+  ObjectType type;
 
   // Esfera
   Vec3 center;
   double radius;
 
-  // Poliedro
+  // Poliedro (faceArrays espelha faces e deve ser refeito ao alterá-las)
   std::vector<Plane> faces;
+  FaceArrays faceArrays;
 
   // Quádricas
   // Equação: Ax^2 + By^2 + Cz^2 + Dxy + Exz + Fyz + Gx + Hy + Iz + J = 0
@@ -100,14 +234,30 @@ struct Object {
   double D, E, F; // xy, xz, yz
   double G, H, I; // x, y, z
   double J;       // constante
+  AABB clip;      // Caixa de recorte (infinita = sem recorte)
 
   // CSG
   std::vector<Object> csgChildren;
   std::vector<CSGOperation> csgOperations;
 
+  // Malha de triângulos (somente leitura, compartilhada entre os objetos
+  // que usam o mesmo arquivo) e o deslocamento do objeto em relação a ela
+  std::shared_ptr<const Mesh> mesh;
+  Vec3 meshOffset;
+
   Object()
-      : type(SPHERE), pigmentIdx(0), finishIdx(0), radius(0), A(0), B(0), C(0),
-        D(0), E(0), F(0), G(0), H(0), I(0), J(0) {}
+      : type(SPHERE), radius(0), A(0), B(0), C(0), D(0), E(0), F(0), G(0),
+        H(0), I(0), J(0), clip(AABB::infinite()) {}
+};
+
+// Instância: registro compacto com o protótipo compartilhado, as
+// transformações de/para o mundo e o material próprio (herdado do protótipo
+// se não informado na cena). Não carrega os campos de geometria de Object.
+struct Instance : SceneItem {
+  int prototypeIdx;
+  Transform toWorld, toLocal;
+
+  Instance() : prototypeIdx(-1) {}
 };
 
 // Luz
@@ -120,6 +270,56 @@ struct Light {
       : position(pos), color(col), attenuation(atten) {}
 };
 
+// Nó da BVH: folha se count > 0 (objetos [first, first + count) em
+// BVH::objects); senão o filho esquerdo é o nó seguinte e o direito é first
+struct BVHNode {
+  AABB bounds;
+  int first;
+  int count;
+};
+
+// Hierarquia de volumes delimitadores sobre os objetos da cena
+struct BVH {
+  std::vector<BVHNode> nodes;
+  std::vector<int> objects;   // Índices de objetos ordenados pelas folhas
+  std::vector<int> unbounded; // Objetos ilimitados, sempre testados
+};
+
+// Malha de triângulos lida de um arquivo OBJ: vértices e índices em vetores
+// contíguos, com uma BVH própria sobre os triângulos
+struct Mesh {
+  std::string path;
+  std::string key; // Arquivo e data de modificação
+  std::vector<Vec3> vertices;
+  std::vector<int> indices;   // 3 vértices por triângulo
+  std::vector<Vec3> normals;  // Normais dos vértices (opcional)
+  std::vector<int> normalIdx; // 3 normais por triângulo, se houver normais
+  BVH bvh;                    // Folhas indexam triângulos
+  AABB bounds;
+
+  size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// Oclusores de uma ou mais luzes: a BVH da cena sem os objetos convexos que
+// envolvem a luz e a câmera (nenhum raio de sombra pode cruzá-los) e sem os
+// que ficam fora do fecho da região dos receptores e do cubo da luz
+struct ShadowCasters {
+  BVH bvh;
+  std::vector<int> culled; // Convexos que envolvem luz e olho (ordenados)
+  double eyeClearance;     // Folga do olho até a borda desses convexos
+  AABB receivers; // Origens válidas (infinita se nada foi descartado por ela)
+};
+
+// Nó da hierarquia de luzes: folha se light >= 0; senão o filho esquerdo é o
+// nó seguinte e o direito é right
+struct LightNode {
+  AABB bounds;
+  double intensity; // Soma da luminância das cores das luzes do nó
+  Vec3 attenuation; // Menores coeficientes de atenuação das luzes do nó
+  int light;
+  int right;
+};
+
 // Estrutura da cena
 struct Scene {
   Vec3 eye;
@@ -131,10 +331,37 @@ struct Scene {
   std::vector<Pigment> pigments;
   std::vector<Finish> finishes;
   std::vector<Object> objects;
+  std::vector<Instance> instances; // Indexadas depois dos objetos
+  std::vector<Object> prototypes;  // Geometria compartilhada por instâncias
+
+  BVH bvh;
+  std::vector<LightNode> lightTree; // Luzes pontuais (exceto a ambiente)
+  std::vector<ShadowCasters> shadowCasters;
+  std::vector<int> lightCasters; // Por luz: índice em shadowCasters ou -1
 
   Scene() : eye(0, 0, 0), lookAt(0, 0, -1), up(0, 1, 0), fovy(40) {}
 };
 
+// Objetos e instâncias compartilham uma numeração: os índices
+// [0, objects.size()) são objetos e os seguintes, instâncias (BVH, hits)
+int sceneItemCount(const Scene &scene) {
+  return (int)(scene.objects.size() + scene.instances.size());
+}
+
+const SceneItem &sceneItem(const Scene &scene, int i) {
+  int objects = (int)scene.objects.size();
+  if (i < objects)
+    return scene.objects[i];
+  return scene.instances[i - objects];
+}
+
+SceneItem &sceneItem(Scene &scene, int i) {
+  int objects = (int)scene.objects.size();
+  if (i < objects)
+    return scene.objects[i];
+  return scene.instances[i - objects];
+}
+
 // Informação de onde o raio atingiu um objeto
 struct HitInfo {
   bool hit;
@@ -146,4 +373,21 @@ struct HitInfo {
   HitInfo() : hit(false), t(1e10), objectIdx(-1) {}
 };
 
+// Candidato de interseção: a distância e o necessário para reconstruir a
+// superfície atingida, cujo ponto e normal só são calculados para o mais
+// próximo (ver finalizeHit)
+struct HitCandidate {
+  double t;
+  const Object *surface;    // Primitiva atingida (folha do CSG, se houver)
+  const Instance *instance; // Instância que contém a primitiva, se houver
+  int face;               // Face atingida do poliedro
+  bool flip;              // Normal invertida (saída do poliedro, diferença)
+
+  HitCandidate()
+      : t(1e10), surface(nullptr), instance(nullptr), face(-1), flip(false) {}
+  HitCandidate(double t, const Object *surface, int face = -1,
+               bool flip = false)
+      : t(t), surface(surface), instance(nullptr), face(face), flip(flip) {}
+};
+
 #endif
@@ -0,0 +1,103 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "vec3.h"
+#include <cmath>
+
+// Transformação afim 3x4 (rotação/escala + translação)
+struct Transform {
+  double m[3][4];
+
+  Transform() {
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 4; j++)
+        m[i][j] = (i == j) ? 1.0 : 0.0;
+  }
+
+  Vec3 applyPoint(const Vec3 &p) const {
+    return Vec3(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+                m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+                m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+  }
+
+  Vec3 applyVector(const Vec3 &v) const {
+    return Vec3(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+                m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+                m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+  }
+
+  // Aplica a transposta da parte linear (normais usam a inversa transposta)
+  Vec3 applyTransposed(const Vec3 &v) const {
+    return Vec3(m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z,
+                m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+                m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z);
+  }
+
+  // Composição: (*this) aplicada depois de t
+  Transform operator*(const Transform &t) const {
+    Transform r;
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 4; j++) {
+        r.m[i][j] = m[i][0] * t.m[0][j] + m[i][1] * t.m[1][j] +
+                    m[i][2] * t.m[2][j] + (j == 3 ? m[i][3] : 0.0);
+      }
+    }
+    return r;
+  }
+
+  Transform inverse() const {
+    Transform r;
+    double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                 m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                 m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    double inv = 1.0 / det;
+
+    r.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inv;
+    r.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inv;
+    r.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv;
+    r.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * inv;
+    r.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv;
+    r.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inv;
+    r.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inv;
+    r.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inv;
+    r.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv;
+
+    // Translação: -R^-1 * t
+    Vec3 t = r.applyVector(Vec3(m[0][3], m[1][3], m[2][3]));
+    r.m[0][3] = -t.x;
+    r.m[1][3] = -t.y;
+    r.m[2][3] = -t.z;
+    return r;
+  }
+
+  static Transform translate(const Vec3 &t) {
+    Transform r;
+    r.m[0][3] = t.x;
+    r.m[1][3] = t.y;
+    r.m[2][3] = t.z;
+    return r;
+  }
+
+  static Transform scale(const Vec3 &s) {
+    Transform r;
+    r.m[0][0] = s.x;
+    r.m[1][1] = s.y;
+    r.m[2][2] = s.z;
+    return r;
+  }
+
+  // Rotação em torno do eixo (0 = x, 1 = y, 2 = z), ângulo em graus
+  static Transform rotate(int axis, double degrees) {
+    Transform r;
+    double rad = degrees * M_PI / 180.0;
+    double c = cos(rad), s = sin(rad);
+    int a = (axis + 1) % 3, b = (axis + 2) % 3;
+    r.m[a][a] = c;
+    r.m[a][b] = -s;
+    r.m[b][a] = s;
+    r.m[b][b] = c;
+    return r;
+  }
+};
+
+#endif
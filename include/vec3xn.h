@@ -0,0 +1,363 @@
+#ifndef VEC3XN_H
+#define VEC3XN_H
+
+#include "vec3.h"
+#include <cfloat>
+#include <cmath>
+
+// Camada de matemática em lote: RealN guarda SIMD_LANES doubles, MaskN o
+// resultado de uma comparação por lane e Vec3xN SIMD_LANES vetores em
+// estrutura de arrays (x, y e z de todas as lanes em registradores
+// separados). O código vetorizado de interseção e sombreamento é escrito
+// uma vez sobre esses tipos; a largura vem do conjunto de instruções do
+// compilador (AVX-512: 8 lanes, AVX2: 4, SSE2: 2, sem SIMD: 1), por exemplo
+// com make ARCH_FLAGS=-march=native. -DSIMD_SCALAR força a versão escalar
+// (usada pelo teste de tests/vec3xn_test.cpp).
+
+#if !defined(SIMD_SCALAR) && defined(__AVX512F__)
+#include <immintrin.h>
+
+const int SIMD_LANES = 8;
+const char SIMD_BACKEND[] = "avx512";
+typedef __m512d SimdReal;
+typedef __mmask8 SimdMask;
+
+SimdReal simdSet1(double s) { return _mm512_set1_pd(s); }
+SimdReal simdLoad(const double *p) { return _mm512_loadu_pd(p); }
+void simdStore(double *p, SimdReal a) { _mm512_storeu_pd(p, a); }
+SimdReal simdAdd(SimdReal a, SimdReal b) { return _mm512_add_pd(a, b); }
+SimdReal simdSub(SimdReal a, SimdReal b) { return _mm512_sub_pd(a, b); }
+SimdReal simdMul(SimdReal a, SimdReal b) { return _mm512_mul_pd(a, b); }
+SimdReal simdDiv(SimdReal a, SimdReal b) { return _mm512_div_pd(a, b); }
+// As formas com máscara e origem explícita evitam o aviso de valor não
+// inicializado (_mm512_undefined_pd) dos cabeçalhos do GCC 12
+const SimdMask SIMD_FULL = (SimdMask)0xFF;
+SimdReal simdMin(SimdReal a, SimdReal b) {
+  return _mm512_mask_min_pd(a, SIMD_FULL, a, b);
+}
+SimdReal simdMax(SimdReal a, SimdReal b) {
+  return _mm512_mask_max_pd(a, SIMD_FULL, a, b);
+}
+SimdReal simdSqrt(SimdReal a) { return _mm512_mask_sqrt_pd(a, SIMD_FULL, a); }
+SimdReal simdAbs(SimdReal a) { return _mm512_abs_pd(a); }
+SimdReal simdNeg(SimdReal a) {
+  return _mm512_castsi512_pd(_mm512_xor_si512(
+      _mm512_castpd_si512(a), _mm512_castpd_si512(_mm512_set1_pd(-0.0))));
+}
+// Estimativa de 1 / sqrt(a) com 14 bits
+SimdReal simdRsqrtEstimate(SimdReal a) {
+  return _mm512_mask_rsqrt14_pd(a, SIMD_FULL, a);
+}
+SimdMask simdLess(SimdReal a, SimdReal b) {
+  return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ);
+}
+SimdMask simdLessEqual(SimdReal a, SimdReal b) {
+  return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ);
+}
+SimdMask simdAnd(SimdMask a, SimdMask b) { return (SimdMask)(a & b); }
+SimdMask simdOr(SimdMask a, SimdMask b) { return (SimdMask)(a | b); }
+SimdMask simdAndNot(SimdMask a, SimdMask b) { return (SimdMask)(~a & b); }
+SimdMask simdNot(SimdMask a) { return (SimdMask)~a; }
+int simdBits(SimdMask m) { return (int)m; }
+SimdReal simdSelect(SimdMask m, SimdReal a, SimdReal b) {
+  return _mm512_mask_blend_pd(m, b, a);
+}
+
+#elif !defined(SIMD_SCALAR) && defined(__AVX2__)
+#include <immintrin.h>
+
+const int SIMD_LANES = 4;
+const char SIMD_BACKEND[] = "avx2";
+typedef __m256d SimdReal;
+typedef __m256d SimdMask; // Lanes com todos os bits ligados ou desligados
+
+SimdReal simdSet1(double s) { return _mm256_set1_pd(s); }
+SimdReal simdLoad(const double *p) { return _mm256_loadu_pd(p); }
+void simdStore(double *p, SimdReal a) { _mm256_storeu_pd(p, a); }
+SimdReal simdAdd(SimdReal a, SimdReal b) { return _mm256_add_pd(a, b); }
+SimdReal simdSub(SimdReal a, SimdReal b) { return _mm256_sub_pd(a, b); }
+SimdReal simdMul(SimdReal a, SimdReal b) { return _mm256_mul_pd(a, b); }
+SimdReal simdDiv(SimdReal a, SimdReal b) { return _mm256_div_pd(a, b); }
+SimdReal simdMin(SimdReal a, SimdReal b) { return _mm256_min_pd(a, b); }
+SimdReal simdMax(SimdReal a, SimdReal b) { return _mm256_max_pd(a, b); }
+SimdReal simdSqrt(SimdReal a) { return _mm256_sqrt_pd(a); }
+SimdReal simdAbs(SimdReal a) {
+  return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a);
+}
+SimdReal simdNeg(SimdReal a) {
+  return _mm256_xor_pd(a, _mm256_set1_pd(-0.0));
+}
+// Estimativa de 1 / sqrt(a) com 12 bits, calculada em float (a precisa
+// estar no alcance do float)
+SimdReal simdRsqrtEstimate(SimdReal a) {
+  return _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(a)));
+}
+SimdMask simdLess(SimdReal a, SimdReal b) {
+  return _mm256_cmp_pd(a, b, _CMP_LT_OQ);
+}
+SimdMask simdLessEqual(SimdReal a, SimdReal b) {
+  return _mm256_cmp_pd(a, b, _CMP_LE_OQ);
+}
+SimdMask simdAnd(SimdMask a, SimdMask b) { return _mm256_and_pd(a, b); }
+SimdMask simdOr(SimdMask a, SimdMask b) { return _mm256_or_pd(a, b); }
+SimdMask simdAndNot(SimdMask a, SimdMask b) { return _mm256_andnot_pd(a, b); }
+SimdMask simdNot(SimdMask a) {
+  return _mm256_xor_pd(a, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)));
+}
+int simdBits(SimdMask m) { return _mm256_movemask_pd(m); }
+SimdReal simdSelect(SimdMask m, SimdReal a, SimdReal b) {
+  return _mm256_blendv_pd(b, a, m);
+}
+
+#elif !defined(SIMD_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+
+const int SIMD_LANES = 2;
+const char SIMD_BACKEND[] = "sse2";
+typedef __m128d SimdReal;
+typedef __m128d SimdMask; // Lanes com todos os bits ligados ou desligados
+
+SimdReal simdSet1(double s) { return _mm_set1_pd(s); }
+SimdReal simdLoad(const double *p) { return _mm_loadu_pd(p); }
+void simdStore(double *p, SimdReal a) { _mm_storeu_pd(p, a); }
+SimdReal simdAdd(SimdReal a, SimdReal b) { return _mm_add_pd(a, b); }
+SimdReal simdSub(SimdReal a, SimdReal b) { return _mm_sub_pd(a, b); }
+SimdReal simdMul(SimdReal a, SimdReal b) { return _mm_mul_pd(a, b); }
+SimdReal simdDiv(SimdReal a, SimdReal b) { return _mm_div_pd(a, b); }
+SimdReal simdMin(SimdReal a, SimdReal b) { return _mm_min_pd(a, b); }
+SimdReal simdMax(SimdReal a, SimdReal b) { return _mm_max_pd(a, b); }
+SimdReal simdSqrt(SimdReal a) { return _mm_sqrt_pd(a); }
+SimdReal simdAbs(SimdReal a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+SimdReal simdNeg(SimdReal a) { return _mm_xor_pd(a, _mm_set1_pd(-0.0)); }
+// Estimativa de 1 / sqrt(a) com 12 bits, calculada em float (a precisa
+// estar no alcance do float)
+SimdReal simdRsqrtEstimate(SimdReal a) {
+  return _mm_cvtps_pd(_mm_rsqrt_ps(_mm_cvtpd_ps(a)));
+}
+SimdMask simdLess(SimdReal a, SimdReal b) { return _mm_cmplt_pd(a, b); }
+SimdMask simdLessEqual(SimdReal a, SimdReal b) { return _mm_cmple_pd(a, b); }
+SimdMask simdAnd(SimdMask a, SimdMask b) { return _mm_and_pd(a, b); }
+SimdMask simdOr(SimdMask a, SimdMask b) { return _mm_or_pd(a, b); }
+SimdMask simdAndNot(SimdMask a, SimdMask b) { return _mm_andnot_pd(a, b); }
+SimdMask simdNot(SimdMask a) {
+  return _mm_xor_pd(a, _mm_castsi128_pd(_mm_set1_epi32(-1)));
+}
+int simdBits(SimdMask m) { return _mm_movemask_pd(m); }
+SimdReal simdSelect(SimdMask m, SimdReal a, SimdReal b) {
+  return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b));
+}
+
+#else
+// Sem SIMD: uma lane, com as mesmas operações em escalar
+
+const int SIMD_LANES = 1;
+const char SIMD_BACKEND[] = "scalar";
+typedef double SimdReal;
+typedef bool SimdMask;
+
+SimdReal simdSet1(double s) { return s; }
+SimdReal simdLoad(const double *p) { return *p; }
+void simdStore(double *p, SimdReal a) { *p = a; }
+SimdReal simdAdd(SimdReal a, SimdReal b) { return a + b; }
+SimdReal simdSub(SimdReal a, SimdReal b) { return a - b; }
+SimdReal simdMul(SimdReal a, SimdReal b) { return a * b; }
+SimdReal simdDiv(SimdReal a, SimdReal b) { return a / b; }
+SimdReal simdMin(SimdReal a, SimdReal b) { return b < a ? b : a; }
+SimdReal simdMax(SimdReal a, SimdReal b) { return b > a ? b : a; }
+SimdReal simdSqrt(SimdReal a) { return sqrt(a); }
+SimdReal simdAbs(SimdReal a) { return fabs(a); }
+SimdReal simdNeg(SimdReal a) { return -a; }
+SimdReal simdRsqrtEstimate(SimdReal a) { return 1.0 / sqrt(a); }
+SimdMask simdLess(SimdReal a, SimdReal b) { return a < b; }
+SimdMask simdLessEqual(SimdReal a, SimdReal b) { return a <= b; }
+SimdMask simdAnd(SimdMask a, SimdMask b) { return a && b; }
+SimdMask simdOr(SimdMask a, SimdMask b) { return a || b; }
+SimdMask simdAndNot(SimdMask a, SimdMask b) { return !a && b; }
+SimdMask simdNot(SimdMask a) { return !a; }
+int simdBits(SimdMask m) { return m ? 1 : 0; }
+SimdReal simdSelect(SimdMask m, SimdReal a, SimdReal b) { return m ? a : b; }
+#endif
+
+// Bits de simdBits com todas as lanes ligadas
+const int SIMD_ALL_LANES = (1 << SIMD_LANES) - 1;
+
+// SIMD_LANES doubles
+struct RealN {
+  SimdReal v;
+
+  RealN() : v(simdSet1(0.0)) {}
+  RealN(double s) : v(simdSet1(s)) {}
+};
+
+// Resultado de uma comparação entre RealN, por lane
+struct MaskN {
+  SimdMask m;
+};
+
+RealN wrapReal(SimdReal v) {
+  RealN r;
+  r.v = v;
+  return r;
+}
+
+MaskN wrapMask(SimdMask m) {
+  MaskN r;
+  r.m = m;
+  return r;
+}
+
+// Lê e grava SIMD_LANES doubles consecutivos (sem exigir alinhamento)
+RealN loadReal(const double *p) { return wrapReal(simdLoad(p)); }
+void storeReal(double *p, const RealN &a) { simdStore(p, a.v); }
+
+RealN operator+(const RealN &a, const RealN &b) {
+  return wrapReal(simdAdd(a.v, b.v));
+}
+RealN operator-(const RealN &a, const RealN &b) {
+  return wrapReal(simdSub(a.v, b.v));
+}
+RealN operator*(const RealN &a, const RealN &b) {
+  return wrapReal(simdMul(a.v, b.v));
+}
+RealN operator/(const RealN &a, const RealN &b) {
+  return wrapReal(simdDiv(a.v, b.v));
+}
+RealN operator-(const RealN &a) { return wrapReal(simdNeg(a.v)); }
+
+RealN min(const RealN &a, const RealN &b) {
+  return wrapReal(simdMin(a.v, b.v));
+}
+RealN max(const RealN &a, const RealN &b) {
+  return wrapReal(simdMax(a.v, b.v));
+}
+RealN sqrt(const RealN &a) { return wrapReal(simdSqrt(a.v)); }
+RealN abs(const RealN &a) { return wrapReal(simdAbs(a.v)); }
+
+// 1 / sqrt(a) correto até o arredondamento (raiz e divisão exatas)
+RealN rsqrt(const RealN &a) { return RealN(1.0) / sqrt(a); }
+
+MaskN operator<(const RealN &a, const RealN &b) {
+  return wrapMask(simdLess(a.v, b.v));
+}
+MaskN operator<=(const RealN &a, const RealN &b) {
+  return wrapMask(simdLessEqual(a.v, b.v));
+}
+MaskN operator>(const RealN &a, const RealN &b) { return b < a; }
+MaskN operator>=(const RealN &a, const RealN &b) { return b <= a; }
+
+MaskN operator&(const MaskN &a, const MaskN &b) {
+  return wrapMask(simdAnd(a.m, b.m));
+}
+MaskN operator|(const MaskN &a, const MaskN &b) {
+  return wrapMask(simdOr(a.m, b.m));
+}
+MaskN operator~(const MaskN &a) { return wrapMask(simdNot(a.m)); }
+// Lanes de b que não estão em a (mais barato que ~a & b)
+MaskN andNot(const MaskN &a, const MaskN &b) {
+  return wrapMask(simdAndNot(a.m, b.m));
+}
+
+// Bit i ligado se a lane i está na máscara
+int maskBits(const MaskN &m) { return simdBits(m.m); }
+bool any(const MaskN &m) { return maskBits(m) != 0; }
+bool all(const MaskN &m) { return maskBits(m) == SIMD_ALL_LANES; }
+
+// Lane de a onde mask está ligada e a de b nas demais, sem desvios
+RealN select(const MaskN &mask, const RealN &a, const RealN &b) {
+  return wrapReal(simdSelect(mask.m, a.v, b.v));
+}
+
+// 1 / sqrt(a) pela estimativa do hardware refinada por Newton-Raphson
+// (y' = y * (1,5 - 0,5 * a * y^2), que dobra os bits corretos): erro
+// relativo abaixo de 1e-13. Fora do alcance normal do float a estimativa
+// do SSE2 e do AVX2 vira 0 ou inf; essas lanes (e o zero) usam rsqrt, para
+// que todos os backends deem o mesmo resultado.
+RealN rsqrtFast(const RealN &a) {
+  RealN y = wrapReal(simdRsqrtEstimate(a.v));
+  RealN half = a * RealN(0.5);
+  for (int i = 0; i < 2; i++)
+    y = y * (RealN(1.5) - half * y * y);
+  MaskN inRange = (a >= RealN(FLT_MIN)) & (a <= RealN(FLT_MAX));
+  if (all(inRange))
+    return y;
+  return select(inRange, y, rsqrt(a));
+}
+
+// Valor da lane i (para reduções e depuração; evite em laços internos)
+double lane(const RealN &a, int i) {
+  double values[SIMD_LANES];
+  storeReal(values, a);
+  return values[i];
+}
+
+// SIMD_LANES vetores em estrutura de arrays
+struct Vec3xN {
+  RealN x, y, z;
+
+  Vec3xN() {}
+  Vec3xN(const RealN &x, const RealN &y, const RealN &z) : x(x), y(y), z(z) {}
+  // O mesmo vetor em todas as lanes
+  Vec3xN(const Vec3 &v) : x(v.x), y(v.y), z(v.z) {}
+
+  Vec3xN operator+(const Vec3xN &v) const {
+    return Vec3xN(x + v.x, y + v.y, z + v.z);
+  }
+  Vec3xN operator-(const Vec3xN &v) const {
+    return Vec3xN(x - v.x, y - v.y, z - v.z);
+  }
+  Vec3xN operator*(const RealN &t) const {
+    return Vec3xN(x * t, y * t, z * t);
+  }
+  Vec3xN operator/(const RealN &t) const {
+    return *this * (RealN(1.0) / t);
+  }
+  Vec3xN operator*(const Vec3xN &v) const {
+    return Vec3xN(x * v.x, y * v.y, z * v.z);
+  }
+  Vec3xN operator-() const { return Vec3xN(-x, -y, -z); }
+
+  RealN dot(const Vec3xN &v) const { return x * v.x + y * v.y + z * v.z; }
+
+  Vec3xN cross(const Vec3xN &v) const {
+    return Vec3xN(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x);
+  }
+
+  RealN length() const { return sqrt(dot(*this)); }
+
+  // Um inverso da raiz por lane no lugar de três divisões; lanes de
+  // comprimento zero ficam zeradas, como em Vec3::normalize
+  Vec3xN normalize() const {
+    RealN len2 = dot(*this);
+    RealN inv = select(len2 > RealN(0.0), rsqrt(len2), RealN(0.0));
+    return *this * inv;
+  }
+};
+
+// Vetor de a onde mask está ligada e o de b nas demais
+Vec3xN select(const MaskN &mask, const Vec3xN &a, const Vec3xN &b) {
+  return Vec3xN(select(mask, a.x, b.x), select(mask, a.y, b.y),
+                select(mask, a.z, b.z));
+}
+
+// Carrega SIMD_LANES vetores de arrays separados (estrutura de arrays)
+Vec3xN loadVec3xN(const double *xs, const double *ys, const double *zs) {
+  return Vec3xN(loadReal(xs), loadReal(ys), loadReal(zs));
+}
+
+// Transpõe SIMD_LANES vetores consecutivos de um array de Vec3
+Vec3xN gatherVec3xN(const Vec3 *v) {
+  double xs[SIMD_LANES], ys[SIMD_LANES], zs[SIMD_LANES];
+  for (int i = 0; i < SIMD_LANES; i++) {
+    xs[i] = v[i].x;
+    ys[i] = v[i].y;
+    zs[i] = v[i].z;
+  }
+  return loadVec3xN(xs, ys, zs);
+}
+
+// Vetor da lane i
+Vec3 lane(const Vec3xN &v, int i) {
+  return Vec3(lane(v.x, i), lane(v.y, i), lane(v.z, i));
+}
+
+#endif
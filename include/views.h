@@ -0,0 +1,201 @@
+#ifndef VIEWS_H
+#define VIEWS_H
+
+#include "render.h"
+#include "structures.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Várias vistas da mesma cena numa única execução (pares estéreo, arranjos
+// de câmeras, cube maps): a cena, as texturas e os dados derivados
+// (BVHs, mapas de sombra) são carregados e montados uma vez para todas.
+
+// Carrega as câmeras de um arquivo com uma vista por linha:
+//   nome ex ey ez lx ly lz ux uy uz fovy
+// (olho, alvo, vetor up e abertura vertical em graus). Linhas vazias e
+// iniciadas por # são ignoradas; o nome vira o sufixo do arquivo de saída.
+bool loadViews(const std::string &filename, std::vector<Camera> &cameras) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Erro: Não foi possível abrir o arquivo de vistas "
+              << filename << std::endl;
+    return false;
+  }
+
+  std::set<std::string> names;
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(file, line)) {
+    lineNumber++;
+    std::istringstream in(line);
+    Camera camera;
+    if (!(in >> camera.name) || camera.name[0] == '#')
+      continue;
+    in >> camera.eye.x >> camera.eye.y >> camera.eye.z;
+    in >> camera.lookAt.x >> camera.lookAt.y >> camera.lookAt.z;
+    in >> camera.up.x >> camera.up.y >> camera.up.z;
+    in >> camera.fovy;
+    if (!in || camera.fovy <= 0 || camera.fovy >= 180) {
+      std::cerr << "Erro: Vista inválida na linha " << lineNumber << " de "
+                << filename << std::endl;
+      return false;
+    }
+    if (!names.insert(camera.name).second) {
+      std::cerr << "Erro: Vista " << camera.name << " repetida em "
+                << filename << std::endl;
+      return false;
+    }
+    cameras.push_back(camera);
+  }
+
+  if (cameras.empty()) {
+    std::cerr << "Erro: Nenhuma vista em " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Par estéreo de eixos paralelos: os olhos (e os alvos) ficam a
+// separation / 2 de cada lado da câmera dada, ao longo do eixo u
+std::vector<Camera> stereoCameras(const Camera &center, double separation) {
+  Vec3 w = (center.eye - center.lookAt).normalize();
+  Vec3 offset = center.up.cross(w).normalize() * (separation / 2.0);
+
+  std::vector<Camera> cameras(2, center);
+  cameras[0].name = "left";
+  cameras[0].eye = center.eye - offset;
+  cameras[0].lookAt = center.lookAt - offset;
+  cameras[1].name = "right";
+  cameras[1].eye = center.eye + offset;
+  cameras[1].lookAt = center.lookAt + offset;
+  return cameras;
+}
+
+// Os 6 lados de um cube map no olho da câmera dada, alinhados aos eixos do
+// mundo (px, nx, py, ny, pz e nz), com abertura de 90 graus. Os lados
+// horizontais têm +y para cima; o de cima tem +z e o de baixo -z, de forma
+// que a borda inferior de py e a superior de ny encostam em nz (a direção
+// da câmera padrão).
+std::vector<Camera> cubemapCameras(const Camera &center) {
+  static const char *names[6] = {"px", "nx", "py", "ny", "pz", "nz"};
+  static const Vec3 directions[6] = {Vec3(1, 0, 0), Vec3(-1, 0, 0),
+                                     Vec3(0, 1, 0), Vec3(0, -1, 0),
+                                     Vec3(0, 0, 1), Vec3(0, 0, -1)};
+  static const Vec3 ups[6] = {Vec3(0, 1, 0), Vec3(0, 1, 0),
+                              Vec3(0, 0, 1), Vec3(0, 0, -1),
+                              Vec3(0, 1, 0), Vec3(0, 1, 0)};
+
+  std::vector<Camera> cameras(6);
+  for (int face = 0; face < 6; face++) {
+    cameras[face].name = names[face];
+    cameras[face].eye = center.eye;
+    cameras[face].lookAt = center.eye + directions[face];
+    cameras[face].up = ups[face];
+    cameras[face].fovy = 90.0;
+  }
+  return cameras;
+}
+
+// Maior distância entre o olho da cena e o de uma das vistas. Os descartes
+// que dependem do olho (shadowBVH, optimizeScene) o tratam como um disco
+// desse raio, somado à abertura da lente, em volta do olho da cena.
+double viewSpread(const Scene &scene, const std::vector<Camera> &cameras) {
+  double spread = 0.0;
+  for (const Camera &camera : cameras)
+    spread = std::max(spread, (camera.eye - scene.eye).length());
+  return spread;
+}
+
+// Renderiza todas as vistas com as mesmas configurações, guardando a
+// imagem da vista i em frameBuffers[i] (e os AOVs em (*aovs)[i], se aovs
+// não for nulo). Os mapas de sombra não dependem da câmera e são montados
+// uma vez; o cache de irradiância parte dos pixels de cada vista e é
+// montado por vista. Os blocos de todas as vistas formam uma única fila,
+// para que as threads não esperem o fim de uma vista para começar a
+// seguinte. O amostrador depende só do pixel, então cada imagem é igual à
+// de uma renderização isolada da mesma câmera.
+void renderViews(const Scene &scene, const RenderSettings &settings,
+                 const std::vector<Camera> &cameras,
+                 std::vector<std::vector<unsigned char>> &frameBuffers,
+                 std::vector<AOVBuffers> *aovs = nullptr) {
+  size_t count = cameras.size();
+  double lensRadius = settings.aperture + viewSpread(scene, cameras);
+
+  ShadowMaps shadowMaps;
+  if (settings.shadowMapSize > 0)
+    buildShadowMaps(scene, settings.shadowMapSize, lensRadius, shadowMaps,
+                    settings.shading.rayCount);
+
+  // Os raios do cache partem dos olhos sem abertura
+  RenderSettings cacheSettings = settings;
+  cacheSettings.shading.lensRadius = lensRadius - settings.aperture;
+  std::vector<IrradianceCache> irradiance(settings.irradianceCache ? count
+                                                                   : 0);
+  for (size_t k = 0; k < irradiance.size(); k++)
+    buildIrradianceCache(scene, cameras[k], cacheSettings, irradiance[k]);
+
+  std::vector<AOVBuffers> localAOVs;
+  if (!aovs && settings.denoise)
+    aovs = &localAOVs;
+  if (aovs)
+    aovs->assign(count, AOVBuffers());
+
+  std::vector<PrimaryView> views(count);
+  std::vector<ShadingOptions> shading(count, settings.shading);
+  frameBuffers.assign(count, std::vector<unsigned char>());
+  for (size_t k = 0; k < count; k++) {
+    setupCamera(scene, cameras[k], settings, views[k]);
+    shading[k].lensRadius = lensRadius;
+    if (settings.shadowMapSize > 0)
+      shading[k].shadowMaps = &shadowMaps;
+    if (settings.irradianceCache)
+      shading[k].irradiance = &irradiance[k];
+    frameBuffers[k].resize(settings.width * settings.height * 3);
+    if (aovs)
+      (*aovs)[k].resize(settings.width, settings.height);
+  }
+
+  // Fila única: (vista, bloco) na ordem das vistas
+  std::vector<Tile> grid = tileGrid(settings);
+  std::vector<std::pair<int, Tile>> queue;
+  for (size_t k = 0; k < count; k++)
+    for (const Tile &tile : grid)
+      queue.push_back(std::make_pair((int)k, tile));
+
+  uint64_t *totalRays = settings.shading.rayCount;
+#pragma omp parallel for schedule(dynamic, 1)
+  for (size_t i = 0; i < queue.size(); i++) {
+    int k = queue[i].first;
+    const Tile &tile = queue[i].second;
+    Sampler sampler(settings.sampler, settings.samples, settings.seed);
+    uint64_t rays = 0;
+    ShadingOptions tileShading = shading[k];
+    if (totalRays)
+      tileShading.rayCount = &rays;
+    AOVBuffers *aov = aovs ? &(*aovs)[k] : nullptr;
+    for (int y = tile.y0; y < tile.y1; y++)
+      for (int x = tile.x0; x < tile.x1; x++)
+        renderPixel(scene, settings, views[k], x, y, sampler, tileShading,
+                    frameBuffers[k], aov);
+    if (totalRays) {
+#pragma omp atomic
+      *totalRays += rays;
+    }
+  }
+
+  if (settings.denoise) {
+    for (size_t k = 0; k < count; k++) {
+      AOVBuffers &aov = (*aovs)[k];
+      denoiseAtrous(aov);
+      for (int p = 0; p < settings.width * settings.height; p++)
+        storePixel(frameBuffers[k], p * 3, aov.color[p].clamp());
+    }
+  }
+}
+
+#endif
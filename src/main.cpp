@@ -1,135 +1,201 @@
+#include "animation.h"
+#include "incremental.h"
 #include "intersect.h"
 #include "loader.h"
+#include "optimize.h"
+#include "options.h"
+#include "render.h"
+#include "server.h"
 #include "shading.h"
 #include "structures.h"
 #include "vec3.h"
+#include "views.h"
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
-#include <ctime>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <sstream>
 #include <vector>
 
-// Tamanho da janela (pode ser sobrescrito por linha de comando)
-int WIDTH = 800;
-int HEIGHT = 600;
-int SAMPLES = 16; // Número de amostras por pixel (Distributed Ray Tracing)
-
-// Parâmetros da câmera para Depth of Field
-double APERTURE = 0.0;    // Raio da abertura da lente (0 = sem DOF)
-double FOCUS_DIST = 10.0; // Distância focal
+// Parâmetros de renderização (podem ser sobrescritos por linha de comando)
+RenderSettings settings;
 
 // Cena a ser renderizada
 Scene scene;
-std::vector<unsigned char> frameBuffer;
-
-// Configuração da câmera
-void setupCamera(const Scene &scene, Vec3 &u, Vec3 &v, Vec3 &w,
-                 double &aspectRatio) {
-  w = (scene.eye - scene.lookAt).normalize();
-  u = scene.up.cross(w).normalize();
-  v = scene.up.normalize();
-  aspectRatio = (double)(WIDTH) / (double)(HEIGHT);
-}
 
-// Renderização da cena
-void renderScene() {
-  srand(time(NULL)); // Inicializa semente aleatória
-  Vec3 u, v, w;
-  double aspectRatio;
-  setupCamera(scene, u, v, w, aspectRatio);
-
-  double fovyRad = scene.fovy * M_PI / 180.0;
-  double viewportHeight = 2.0 * tan(fovyRad / 2.0);
-  double viewportWidth = viewportHeight * aspectRatio;
-
-  frameBuffer.resize(WIDTH * HEIGHT * 3);
-
-  for (int y = 0; y < HEIGHT; y++) {
-    for (int x = 0; x < WIDTH; x++) {
-      Vec3 pixelColor(0, 0, 0);
-
-      // Superamostragem
-      for (int s = 0; s < SAMPLES; s++) {
-        // Jittering - deslocamento aleatório dentro do pixel
-        double jitterX = (double)rand() / (double)RAND_MAX;
-        double jitterY = (double)rand() / (double)RAND_MAX;
-
-        // Calcula coordenadas normalizadas do dispositivo com jitter
-        double ndcX = (2.0 * (x + jitterX) / WIDTH) - 1.0;
-        double ndcY = 1.0 - (2.0 * (y + jitterY) / HEIGHT);
-
-        // Calcula direção do raio (sem DOF)
-        Vec3 rayDir = u * (ndcX * viewportWidth / 2.0) +
-                      v * (ndcY * viewportHeight / 2.0) - w;
-        rayDir = rayDir.normalize();
-
-        // DoF - Amostra ponto aleatório no disco da abertura
-        Vec3 rayOrigin = scene.eye;
-        if (APERTURE > 0.0) {
-          // Amostragem aleatória em disco unitário
-          double dx, dy;
-          do {
-            dx = ((double)rand() / RAND_MAX) * 2.0 - 1.0;
-            dy = ((double)rand() / RAND_MAX) * 2.0 - 1.0;
-          } while (dx * dx + dy * dy > 1.0);
-
-          // Offset da origem do raio na abertura
-          Vec3 offset = u * (dx * APERTURE) + v * (dy * APERTURE);
-          rayOrigin = scene.eye + offset;
-
-          // Ponto de foco na distância focal
-          Vec3 focusPoint = scene.eye + rayDir * FOCUS_DIST;
-
-          // Nova direção do raio da origem offset para o ponto de foco
-          rayDir = (focusPoint - rayOrigin).normalize();
-        }
-
-        Ray ray(rayOrigin, rayDir);
-        pixelColor = pixelColor + traceRay(ray, scene, 0);
-      }
+// Renderiza todos os quadros de uma animação com a cena carregada uma vez.
+// A gravação de cada quadro ocorre em paralelo à renderização do seguinte.
+bool renderAnimation(const Animation &anim, const std::string &outputPrefix) {
+  std::map<int, Vec3> offsets;
+  std::vector<unsigned char> buffers[2];
+  std::future<bool> pendingWrite;
+  bool ok = true;
+
+  for (int frame = 0; frame < anim.numFrames; frame++) {
+    applyAnimationFrame(anim, frame, scene, offsets);
+
+    std::vector<unsigned char> &buffer = buffers[frame % 2];
+    renderScene(scene, settings, buffer);
+
+    // Espera a gravação anterior antes de liberar o outro buffer
+    if (pendingWrite.valid())
+      ok = pendingWrite.get() && ok;
+
+    char name[32];
+    snprintf(name, sizeof(name), "_%04d.ppm", frame);
+    std::string filename = outputPrefix + name;
+    std::cout << "Quadro " << frame + 1 << "/" << anim.numFrames << " -> "
+              << filename << std::endl;
+    pendingWrite = std::async(std::launch::async, [filename, &buffer]() {
+      return savePPM(filename, buffer, settings.width, settings.height);
+    });
+  }
 
-      // Média das amostras
-      pixelColor = pixelColor / (double)SAMPLES;
+  if (pendingWrite.valid())
+    ok = pendingWrite.get() && ok;
+  return ok;
+}
 
-      // Armazena a cor no buffer de quadros
-      int idx = (y * WIDTH + x) * 3;
-      frameBuffer[idx + 0] = (unsigned char)(pixelColor.x * 255);
-      frameBuffer[idx + 1] = (unsigned char)(pixelColor.y * 255);
-      frameBuffer[idx + 2] = (unsigned char)(pixelColor.z * 255);
+// Nome da saída sem a extensão: prefixo dos AOVs e das vistas
+std::string outputPrefix(const std::string &outputFile) {
+  std::string prefix = outputFile;
+  size_t dot = prefix.find_last_of('.');
+  if (dot != std::string::npos && dot > prefix.find_last_of('/') + 1)
+    prefix.erase(dot);
+  return prefix;
+}
+
+// Função principal
+int main(int argc, char **argv) {
+  // Modo servidor: --server [socket] (sem socket, lê trabalhos da entrada)
+  if (argc >= 2 && std::string(argv[1]) == "--server") {
+    RenderServer server(8, 64);
+    if (argc >= 3) {
+      std::cout << "Servidor escutando em " << argv[2] << std::endl;
+      return serveUnixSocket(server, argv[2]) ? 0 : 1;
     }
+    serveStream(server, std::cin, std::cout);
+    return 0;
   }
-}
 
-// Salva a imagem em um arquivo PPM
-bool savePPM(const std::string &filename) {
-  std::ofstream file(filename);
-  if (!file.is_open()) {
-    std::cerr << "Erro: Não foi possível criar o arquivo de saída " << filename
+  // Opções nomeadas podem aparecer em qualquer posição
+  std::vector<char *> args(argv, argv + argc);
+  std::string optionValue;
+  if (takeOption(args, "--samples", optionValue)) {
+    settings.samples = std::atoi(optionValue.c_str());
+    if (settings.samples <= 0) {
+      std::cerr << "Erro: Valor inválido para amostras" << std::endl;
+      return 1;
+    }
+  }
+  if (takeOption(args, "--sampler", optionValue) &&
+      !parseSamplerType(optionValue, settings.sampler)) {
+    std::cerr << "Erro: Amostrador desconhecido " << optionValue << std::endl;
+    return 1;
+  }
+  if (takeOption(args, "--light-samples", optionValue)) {
+    settings.shading.lightSamples = std::atoi(optionValue.c_str());
+    if (settings.shading.lightSamples < 0) {
+      std::cerr << "Erro: Valor inválido para amostras de luz" << std::endl;
+      return 1;
+    }
+  }
+  if (takeOption(args, "--pilot", optionValue)) {
+    settings.pilotScale = std::atoi(optionValue.c_str());
+    if (settings.pilotScale < 2) {
+      std::cerr << "Erro: Valor inválido para a redução do piloto"
+                << std::endl;
+      return 1;
+    }
+  }
+  std::string previewFile;
+  if (takeOption(args, "--preview", previewFile) && settings.pilotScale == 0)
+    settings.pilotScale = PILOT_DEFAULT_SCALE;
+  if (takeOption(args, "--seed", optionValue))
+    settings.seed = (uint32_t)std::strtoul(optionValue.c_str(), nullptr, 10);
+  settings.denoise = takeFlag(args, "--denoise");
+  bool writeAOVs = takeFlag(args, "--aov");
+  bool optimize = !takeFlag(args, "--no-optimize");
+  settings.irradianceCache = takeFlag(args, "--irradiance-cache");
+  if (takeOption(args, "--shadow-maps", optionValue)) {
+    settings.shadowMapSize = std::atoi(optionValue.c_str());
+    if (settings.shadowMapSize <= 0) {
+      std::cerr << "Erro: Valor inválido para a resolução dos mapas de sombra"
+                << std::endl;
+      return 1;
+    }
+  }
+  // Várias vistas: arquivo de câmeras, par estéreo ou cube map
+  std::string viewsFile;
+  takeOption(args, "--views", viewsFile);
+  double stereoSeparation = 0.0;
+  bool stereo = takeOption(args, "--stereo", optionValue);
+  if (stereo) {
+    stereoSeparation = std::atof(optionValue.c_str());
+    if (stereoSeparation <= 0) {
+      std::cerr << "Erro: Valor inválido para a distância entre os olhos"
+                << std::endl;
+      return 1;
+    }
+  }
+  bool cubemap = takeFlag(args, "--cubemap");
+  bool multiView = !viewsFile.empty() || stereo || cubemap;
+  if ((!viewsFile.empty()) + stereo + cubemap > 1) {
+    std::cerr << "Erro: Use apenas uma de --views, --stereo e --cubemap"
               << std::endl;
-    return false;
+    return 1;
   }
-
-  file << "P3\n";
-  file << "# Imagem raytracing\n";
-  file << WIDTH << " " << HEIGHT << "\n";
-  file << "255\n";
-
-  for (int y = 0; y < HEIGHT; y++) {
-    for (int x = 0; x < WIDTH; x++) {
-      int idx = (y * WIDTH + x) * 3;
-      file << (int)frameBuffer[idx + 0] << " " << (int)frameBuffer[idx + 1]
-           << " " << (int)frameBuffer[idx + 2] << " ";
+  if (multiView && settings.pilotScale) {
+    std::cerr << "Erro: --pilot e --preview não podem ser usados com "
+                 "várias vistas"
+              << std::endl;
+    return 1;
+  }
+  bool incremental = takeFlag(args, "--incremental");
+  if (incremental && multiView) {
+    std::cerr << "Erro: --incremental não pode ser usado com várias vistas"
+              << std::endl;
+    return 1;
+  }
+  if (incremental && (settings.denoise || writeAOVs ||
+                      settings.irradianceCache || settings.shadowMapSize)) {
+    std::cerr << "Erro: --incremental não pode ser usado com --denoise, "
+                 "--aov, --irradiance-cache ou --shadow-maps"
+              << std::endl;
+    return 1;
+  }
+  argc = (int)args.size();
+  argv = args.data();
+
+  // Modo animação: --animate <cena.in> <animação> <prefixo_saída> [...]
+  std::string animationFile;
+  if (argc >= 2 && std::string(argv[1]) == "--animate") {
+    if (argc < 5) {
+      std::cerr << "Uso: " << argv[0]
+                << " --animate <input_scene.in> <animation.txt> "
+                   "<output_prefix> [width] [height] [aperture] [focus_dist]"
+                << std::endl;
+      return 1;
+    }
+    if (incremental || multiView) {
+      std::cerr << "Erro: --animate não pode ser usado com --incremental "
+                   "nem com várias vistas"
+                << std::endl;
+      return 1;
     }
-    file << "\n";
+    // Remove a flag e o arquivo de animação, mantendo a leitura posicional
+    animationFile = argv[3];
+    args.erase(args.begin() + 3);
+    args.erase(args.begin() + 1);
+    argc = (int)args.size();
+    argv = args.data();
   }
 
-  file.close();
-  return true;
-}
-
-// Função principal
-int main(int argc, char **argv) {
   // Ler argumentos da linha de comando
   if (argc < 3) {
     std::cerr << "Uso: " << argv[0]
@@ -147,6 +213,47 @@ int main(int argc, char **argv) {
               << std::endl;
     std::cerr << "  focus_dist      - Distância focal (opcional, padrão: 10.0)"
               << std::endl;
+    std::cerr << "Opções:" << std::endl;
+    std::cerr << "  --samples N     - Amostras por pixel (padrão: 16)"
+              << std::endl;
+    std::cerr << "  --sampler NOME  - random, stratified, halton ou sobol "
+                 "(padrão: sobol)"
+              << std::endl;
+    std::cerr << "  --seed N        - Semente das amostras (padrão: 0)"
+              << std::endl;
+    std::cerr << "  --light-samples N - Luzes sorteadas por ponto, 0 = todas "
+                 "(padrão: 8)"
+              << std::endl;
+    std::cerr << "  --denoise       - Filtra o ruído guiado pelos AOVs"
+              << std::endl;
+    std::cerr << "  --aov           - Salva albedo, normal, profundidade e id"
+              << std::endl;
+    std::cerr << "  --pilot N       - Passo piloto em 1/N da resolução para "
+                 "escalonar os blocos"
+              << std::endl;
+    std::cerr << "  --preview ARQ   - Salva a imagem do passo piloto (implica "
+                 "--pilot 4)"
+              << std::endl;
+    std::cerr << "  --irradiance-cache - Reaproveita as sombras entre hits "
+                 "difusos próximos"
+              << std::endl;
+    std::cerr << "  --shadow-maps N - Rascunho: mapas de sombra NxN por lado "
+                 "no lugar dos raios de sombra"
+              << std::endl;
+    std::cerr << "  --no-optimize   - Mantém a geometria como descrita na cena"
+              << std::endl;
+    std::cerr << "  --incremental   - Refaz só o que mudou desde a última "
+                 "execução (estado em SAIDA.state)"
+              << std::endl;
+    std::cerr << "  --views ARQ     - Renderiza as câmeras do arquivo "
+                 "(saídas SAIDA_nome.ppm)"
+              << std::endl;
+    std::cerr << "  --stereo D      - Par estéreo com olhos a D de distância "
+                 "(SAIDA_left, SAIDA_right)"
+              << std::endl;
+    std::cerr << "  --cubemap       - 6 lados de 90 graus no olho da cena "
+                 "(SAIDA_px ... SAIDA_nz)"
+              << std::endl;
     return 1;
   }
 
@@ -155,66 +262,185 @@ int main(int argc, char **argv) {
 
   // Ler largura e altura opcionais
   if (argc >= 4) {
-    WIDTH = std::atoi(argv[3]);
-    if (WIDTH <= 0) {
+    settings.width = std::atoi(argv[3]);
+    if (settings.width <= 0) {
       std::cerr << "Erro: Valor inválido para largura" << std::endl;
       return 1;
     }
   }
 
   if (argc >= 5) {
-    HEIGHT = std::atoi(argv[4]);
-    if (HEIGHT <= 0) {
+    settings.height = std::atoi(argv[4]);
+    if (settings.height <= 0) {
       std::cerr << "Erro: Valor inválido para altura" << std::endl;
       return 1;
     }
   }
 
   if (argc >= 6) {
-    APERTURE = std::atof(argv[5]);
-    if (APERTURE < 0) {
+    settings.aperture = std::atof(argv[5]);
+    if (settings.aperture < 0) {
       std::cerr << "Erro: Valor inválido para abertura" << std::endl;
       return 1;
     }
   }
 
   if (argc >= 7) {
-    FOCUS_DIST = std::atof(argv[6]);
-    if (FOCUS_DIST <= 0) {
+    settings.focusDist = std::atof(argv[6]);
+    if (settings.focusDist <= 0) {
       std::cerr << "Erro: Valor inválido para distância focal" << std::endl;
       return 1;
     }
   }
 
+  if (cubemap && settings.width != settings.height) {
+    std::cerr << "Erro: --cubemap exige largura igual à altura" << std::endl;
+    return 1;
+  }
+
   std::cout << "=== Ray Tracer - TP2 ===" << std::endl;
   std::cout << "Arquivo de entrada: " << inputFile << std::endl;
   std::cout << "Arquivo de saída: " << outputFile << std::endl;
-  std::cout << "Resolução: " << WIDTH << "x" << HEIGHT << std::endl;
-  std::cout << "Abertura: " << APERTURE << std::endl;
-  std::cout << "Distância focal: " << FOCUS_DIST << std::endl;
+  std::cout << "Resolução: " << settings.width << "x" << settings.height
+            << std::endl;
+  std::cout << "Abertura: " << settings.aperture << std::endl;
+  std::cout << "Distância focal: " << settings.focusDist << std::endl;
+  std::cout << "Amostras: " << settings.samples
+            << (settings.denoise ? " (com denoise)" : "") << std::endl;
   std::cout << std::endl;
 
   std::cout << "Carregando cena de " << inputFile << "..." << std::endl;
-  if (!loadScene(inputFile, scene)) {
+  // O texto da cena também é guardado pelo modo incremental, para
+  // compará-la na próxima execução
+  std::string sceneText;
+  if (!readSceneText(inputFile, sceneText)) {
+    std::cerr << "Falha ao carregar a cena!" << std::endl;
+    return 1;
+  }
+  std::istringstream sceneStream(sceneText);
+  if (!loadScene(sceneStream, scene)) {
     std::cerr << "Falha ao carregar a cena!" << std::endl;
     return 1;
   }
 
   std::cout << "Cena carregada com sucesso!" << std::endl;
+  std::vector<Camera> cameras;
+  if (!viewsFile.empty() && !loadViews(viewsFile, cameras))
+    return 1;
+  if (stereo)
+    cameras = stereoCameras(sceneCamera(scene), stereoSeparation);
+  if (cubemap)
+    cameras = cubemapCameras(sceneCamera(scene));
+
+  OptimizeOptions options;
+  // As vistas espalham o olho em volta do da cena (ver viewSpread)
+  options.lensRadius = settings.aperture + viewSpread(scene, cameras);
+  if (!animationFile.empty() || incremental) {
+    // Animações e o estado incremental se referem aos objetos pelo índice;
+    // animações também movem a câmera
+    options.removeUnreachable = false;
+    if (!animationFile.empty())
+      options.lensRadius = std::numeric_limits<double>::infinity();
+  }
+  if (optimize)
+    printOptimizeReport(optimizeScene(scene, options), std::cout);
   std::cout << "  Luzes: " << scene.lights.size() << std::endl;
   std::cout << "  Pigmentos: " << scene.pigments.size() << std::endl;
   std::cout << "  Acabamentos: " << scene.finishes.size() << std::endl;
   std::cout << "  Objetos: " << scene.objects.size() << std::endl;
+  if (!scene.instances.empty())
+    std::cout << "  Instâncias: " << scene.instances.size() << std::endl;
   std::cout << std::endl;
 
+  if (!animationFile.empty()) {
+    Animation anim;
+    if (!loadAnimation(animationFile, anim))
+      return 1;
+
+    std::cout << "Renderizando animação (" << anim.numFrames << " quadros)..."
+              << std::endl;
+    if (!renderAnimation(anim, outputFile)) {
+      std::cerr << "Falha ao salvar a animação!" << std::endl;
+      return 1;
+    }
+    std::cout << "Animação salva." << std::endl;
+    return 0;
+  }
+
+  if (multiView) {
+    std::cout << "Renderizando " << cameras.size() << " vistas..."
+              << std::endl;
+    std::vector<std::vector<unsigned char>> frameBuffers;
+    std::vector<AOVBuffers> aovs;
+    uint64_t rayCount = 0;
+    settings.shading.rayCount = &rayCount;
+    auto renderStart = std::chrono::steady_clock::now();
+    renderViews(scene, settings, cameras, frameBuffers,
+                writeAOVs ? &aovs : nullptr);
+    std::chrono::duration<double> renderTime =
+        std::chrono::steady_clock::now() - renderStart;
+    printRenderStats(renderTime.count(), rayCount, std::cout);
+
+    std::string prefix = outputPrefix(outputFile);
+    for (size_t k = 0; k < cameras.size(); k++) {
+      std::string viewPrefix = prefix + "_" + cameras[k].name;
+      std::cout << "Vista " << cameras[k].name << " -> " << viewPrefix
+                << ".ppm" << std::endl;
+      if (!savePPM(viewPrefix + ".ppm", frameBuffers[k], settings.width,
+                   settings.height) ||
+          (writeAOVs && !saveAOVs(viewPrefix, aovs[k]))) {
+        std::cerr << "Falha ao salvar a vista " << cameras[k].name << "!"
+                  << std::endl;
+        return 1;
+      }
+    }
+    std::cout << "Vistas salvas." << std::endl << std::endl;
+    return 0;
+  }
+
+  std::vector<unsigned char> frameBuffer;
+  AOVBuffers aov;
   std::cout << "Renderizando cena..." << std::endl;
-  renderScene();
+  PreviewCallback savePreview = nullptr;
+  if (!previewFile.empty()) {
+    savePreview = [&previewFile](const std::vector<unsigned char> &image,
+                                 int width, int height) {
+      if (savePPM(previewFile, image, width, height))
+        std::cout << "Prévia salva em " << previewFile << std::endl;
+    };
+  }
+  uint64_t rayCount = 0;
+  settings.shading.rayCount = &rayCount;
+  auto renderStart = std::chrono::steady_clock::now();
+  if (incremental) {
+    IncrementalReport report;
+    if (!renderIncremental(scene, sceneText, optimize ? &options : nullptr,
+                           settings, outputFile + ".state", frameBuffer,
+                           report))
+      return 1;
+    printIncrementalReport(report, std::cout);
+  } else {
+    renderScene(scene, settings, frameBuffer, writeAOVs ? &aov : nullptr,
+                savePreview);
+  }
+  std::chrono::duration<double> renderTime =
+      std::chrono::steady_clock::now() - renderStart;
+  printRenderStats(renderTime.count(), rayCount, std::cout);
   std::cout << "Salvando imagem em " << outputFile << "..." << std::endl;
-  if (!savePPM(outputFile)) {
+  if (!savePPM(outputFile, frameBuffer, settings.width, settings.height)) {
     std::cerr << "Falha ao salvar a imagem!" << std::endl;
     return 1;
   }
   std::cout << "Imagem salva." << std::endl;
+
+  if (writeAOVs) {
+    std::string prefix = outputPrefix(outputFile);
+    if (!saveAOVs(prefix, aov)) {
+      std::cerr << "Falha ao salvar os AOVs!" << std::endl;
+      return 1;
+    }
+    std::cout << "AOVs salvos em " << prefix << "_*.ppm" << std::endl;
+  }
   std::cout << std::endl;
 
   return 0;
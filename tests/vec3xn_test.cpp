@@ -0,0 +1,131 @@
+// Teste da camada em lote (include/vec3xn.h): compara add, dot, cross,
+// normalize, select e rsqrtFast, lane a lane, com Vec3 e a raiz escalar.
+// O make vec3xn-test compila este arquivo uma vez por backend e passa o
+// nome esperado, para detectar flags que escolham outra largura.
+// Termina com código 1 se alguma diferença ficar fora da tolerância.
+
+#include "vec3xn.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+const int TEST_GROUPS = 256;         // Grupos de SIMD_LANES vetores sorteados
+const double TEST_EXACT_TOL = 1e-14; // Erro relativo das operações exatas
+const double TEST_RSQRT_TOL = 1e-13; // Erro relativo de rsqrtFast
+
+int failures = 0;
+
+// Compara com tolerância relativa à escala dos operandos (a contração em
+// FMA, ligada com AVX-512, muda o último bit de dot e cross)
+void check(const char *op, int group, int lane, double got, double want,
+           double scale, double tol) {
+  bool same = (std::isnan(got) && std::isnan(want)) || got == want ||
+              std::fabs(got - want) <= tol * scale;
+  if (same)
+    return;
+  if (failures++ < 10)
+    std::cerr << std::setprecision(17) << "Erro: " << op
+              << " difere no grupo " << group << ", lane " << lane << ": "
+              << got << " em vez de " << want << std::endl;
+}
+
+void checkVec(const char *op, int group, int lane, const Vec3 &got,
+              const Vec3 &want, double scale, double tol) {
+  check(op, group, lane, got.x, want.x, scale, tol);
+  check(op, group, lane, got.y, want.y, scale, tol);
+  check(op, group, lane, got.z, want.z, scale, tol);
+}
+
+double magnitude(const Vec3 &v) {
+  return std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+}
+
+// Operações de vetor com entradas sorteadas (algumas lanes zeradas, para o
+// caso de comprimento zero de normalize)
+void testVectors(std::mt19937 &rng) {
+  std::uniform_real_distribution<double> coord(-100.0, 100.0);
+  for (int g = 0; g < TEST_GROUPS; g++) {
+    Vec3 a[SIMD_LANES], b[SIMD_LANES];
+    for (int i = 0; i < SIMD_LANES; i++) {
+      a[i] = Vec3(coord(rng), coord(rng), coord(rng));
+      b[i] = Vec3(coord(rng), coord(rng), coord(rng));
+      if ((g + i) % 7 == 0)
+        a[i] = Vec3(0, 0, 0);
+    }
+    Vec3xN va = gatherVec3xN(a), vb = gatherVec3xN(b);
+
+    Vec3xN sum = va + vb;
+    RealN dot = va.dot(vb);
+    Vec3xN cross = va.cross(vb);
+    Vec3xN unit = va.normalize();
+    MaskN closer = va.x < vb.x;
+    Vec3xN chosen = select(closer, va, vb);
+    int bits = maskBits(closer);
+
+    for (int i = 0; i < SIMD_LANES; i++) {
+      double scale = magnitude(a[i]) * magnitude(b[i]);
+      checkVec("add", g, i, lane(sum, i), a[i] + b[i],
+               magnitude(a[i]) + magnitude(b[i]), TEST_EXACT_TOL);
+      check("dot", g, i, lane(dot, i), a[i].dot(b[i]), scale, TEST_EXACT_TOL);
+      checkVec("cross", g, i, lane(cross, i), a[i].cross(b[i]), scale,
+               TEST_EXACT_TOL);
+      checkVec("normalize", g, i, lane(unit, i), a[i].normalize(), 1.0,
+               TEST_EXACT_TOL);
+
+      bool want = a[i].x < b[i].x;
+      check("mask", g, i, (bits >> i) & 1, want, 0.0, 0.0);
+      checkVec("select", g, i, lane(chosen, i), want ? a[i] : b[i], 0.0, 0.0);
+    }
+  }
+}
+
+// rsqrtFast em todo o alcance do double, inclusive fora do alcance do float
+// (onde o resultado deve ser o mesmo da raiz exata em todos os backends)
+void testRsqrt(std::mt19937 &rng) {
+  std::vector<double> values = {0.0,     FLT_MIN,        FLT_MIN * 0.5,
+                                1e-40,   1e-100,         1e-310,
+                                FLT_MAX, FLT_MAX * 2.0,  1e39,
+                                1e300,   DBL_MAX,        1.0,
+                                0.25,    2.0,            1e-30};
+  std::uniform_real_distribution<double> exponent(-300.0, 300.0);
+  while ((int)values.size() < TEST_GROUPS * SIMD_LANES)
+    values.push_back(std::pow(10.0, exponent(rng)));
+  while (values.size() % SIMD_LANES != 0)
+    values.push_back(1.0);
+
+  for (size_t g = 0; g < values.size(); g += SIMD_LANES) {
+    RealN fast = rsqrtFast(loadReal(&values[g]));
+    for (int i = 0; i < SIMD_LANES; i++) {
+      double a = values[g + i];
+      double want = 1.0 / std::sqrt(a);
+      bool inFloat = a >= FLT_MIN && a <= FLT_MAX;
+      check("rsqrtFast", (int)(g / SIMD_LANES), i, lane(fast, i), want,
+            std::fabs(want), inFloat ? TEST_RSQRT_TOL : 0.0);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && std::strcmp(argv[1], SIMD_BACKEND) != 0) {
+    std::cerr << "Erro: backend " << SIMD_BACKEND << " em vez de " << argv[1]
+              << std::endl;
+    return 1;
+  }
+
+  std::mt19937 rng(47);
+  testVectors(rng);
+  testRsqrt(rng);
+
+  if (failures > 0) {
+    std::cerr << "vec3xn (" << SIMD_BACKEND << "): " << failures
+              << " diferenças" << std::endl;
+    return 1;
+  }
+  std::cout << "vec3xn (" << SIMD_BACKEND << ", " << SIMD_LANES
+            << " lanes): ok" << std::endl;
+  return 0;
+}
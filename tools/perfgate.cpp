@@ -0,0 +1,477 @@
+// Porta de desempenho: renderiza um conjunto fixo de cenas com o a.out,
+// registra tempo, raios por segundo e pico de memória num histórico JSON
+// (um registro por linha) e compara cada imagem com uma referência por PSNR
+// e SSIM. Termina com código 1 se alguma cena ficar mais lenta que a
+// tolerância em relação ao histórico ou perder qualidade.
+
+#include "loader.h"
+#include "options.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <omp.h>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+const double PERF_PSNR_CAP = 99.0;  // PSNR de imagens idênticas
+const int PERF_BASELINE_RUNS = 5;   // Registros do histórico na mediana
+const int PERF_SSIM_WINDOW = 8;     // Janela do SSIM (pixels)
+const double PERF_MIN_DELTA = 0.05; // Variações menores (s) são ignoradas
+
+// Cena da lista: nome, arquivo e argumentos repassados ao a.out
+struct PerfCase {
+  std::string name;
+  std::string scene;
+  std::vector<std::string> args;
+
+  // Identifica a configuração no histórico: mudar resolução ou opções
+  // começa uma nova linha de base
+  std::string config() const {
+    std::string joined = scene;
+    for (const std::string &arg : args)
+      joined += " " + arg;
+    return joined;
+  }
+};
+
+struct PerfSettings {
+  std::string executable = "./a.out";
+  std::string referenceDir = "tests/perf/ref";
+  std::string outputDir = "obj/perf";
+  std::string history = "perf_history.jsonl";
+  int runs = 3;
+  double tolerance = 0.15; // Lentidão aceita em relação à linha de base
+  double minPSNR = 38.0;
+  double minSSIM = 0.98;
+  bool update = false; // Regrava as referências em vez de comparar
+};
+
+struct PerfResult {
+  double wall = 0;   // Menor tempo total entre as execuções (s)
+  double render = 0; // Menor tempo de renderização informado (s)
+  uint64_t rays = 0;
+  long peakRSS = 0; // Maior pico de memória residente (KB)
+  double baseline = 0;
+  double psnr = 0, ssim = 0;
+  std::string status;
+};
+
+// Lê a lista de cenas: "nome cena argumentos..." por linha; linhas vazias
+// ou iniciadas por # são ignoradas
+bool loadCases(const std::string &filename, std::vector<PerfCase> &cases) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Erro: Não foi possível abrir a lista " << filename
+              << std::endl;
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    PerfCase perfCase;
+    if (!(fields >> perfCase.name) || perfCase.name[0] == '#')
+      continue;
+    if (!(fields >> perfCase.scene)) {
+      std::cerr << "Erro: Cena ausente para " << perfCase.name << std::endl;
+      return false;
+    }
+    std::string arg;
+    while (fields >> arg)
+      perfCase.args.push_back(arg);
+    cases.push_back(perfCase);
+  }
+  return true;
+}
+
+// Executa o renderizador capturando a saída padrão; devolve o tempo total e
+// o pico de memória do processo filho
+bool runRenderer(const std::string &executable,
+                 const std::vector<std::string> &args, std::string &output,
+                 double &wall, long &peakRSS) {
+  int pipeFds[2];
+  if (pipe(pipeFds) != 0) {
+    std::cerr << "Erro: Falha ao criar o pipe" << std::endl;
+    return false;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+  if (pid < 0) {
+    std::cerr << "Erro: Falha ao criar o processo" << std::endl;
+    close(pipeFds[0]);
+    close(pipeFds[1]);
+    return false;
+  }
+  if (pid == 0) {
+    dup2(pipeFds[1], STDOUT_FILENO);
+    close(pipeFds[0]);
+    close(pipeFds[1]);
+    std::vector<char *> argv;
+    argv.push_back((char *)executable.c_str());
+    for (const std::string &arg : args)
+      argv.push_back((char *)arg.c_str());
+    argv.push_back(nullptr);
+    execv(executable.c_str(), argv.data());
+    std::cerr << "Erro: Não foi possível executar " << executable
+              << std::endl;
+    _exit(127);
+  }
+
+  close(pipeFds[1]);
+  output.clear();
+  char buffer[4096];
+  ssize_t count;
+  while ((count = read(pipeFds[0], buffer, sizeof(buffer))) > 0)
+    output.append(buffer, count);
+  close(pipeFds[0]);
+
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0)
+    return false;
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  wall = elapsed.count();
+  peakRSS = usage.ru_maxrss;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Valor numérico após o rótulo na saída do a.out (ver printRenderStats)
+bool findValue(const std::string &output, const std::string &label,
+               double &value) {
+  size_t pos = output.find(label);
+  if (pos == std::string::npos)
+    return false;
+  value = strtod(output.c_str() + pos + label.size(), nullptr);
+  return true;
+}
+
+// Relação sinal-ruído de pico entre as imagens (cores em [0, 1])
+double computePSNR(const Texture &a, const Texture &b) {
+  double sum = 0;
+  for (size_t i = 0; i < a.data.size(); i++) {
+    Vec3 d = a.data[i] - b.data[i];
+    sum += d.dot(d);
+  }
+  double mse = sum / (3.0 * a.data.size());
+  if (mse <= 0)
+    return PERF_PSNR_CAP;
+  return std::min(PERF_PSNR_CAP, -10.0 * log10(mse));
+}
+
+// SSIM médio da luminância em janelas de PERF_SSIM_WINDOW pixels com passo
+// de meia janela
+double computeSSIM(const Texture &a, const Texture &b) {
+  const double c1 = 0.01 * 0.01, c2 = 0.03 * 0.03;
+  auto luma = [](const Vec3 &c) {
+    return 0.299 * c.x + 0.587 * c.y + 0.114 * c.z;
+  };
+  int window = std::min(PERF_SSIM_WINDOW, std::min(a.width, a.height));
+  int step = std::max(1, window / 2);
+  double total = 0;
+  int windows = 0;
+  for (int y0 = 0; y0 + window <= a.height; y0 += step) {
+    for (int x0 = 0; x0 + window <= a.width; x0 += step) {
+      double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+      for (int y = y0; y < y0 + window; y++) {
+        for (int x = x0; x < x0 + window; x++) {
+          double la = luma(a.data[y * a.width + x]);
+          double lb = luma(b.data[y * b.width + x]);
+          sa += la;
+          sb += lb;
+          saa += la * la;
+          sbb += lb * lb;
+          sab += la * lb;
+        }
+      }
+      double n = window * window;
+      double ma = sa / n, mb = sb / n;
+      double va = saa / n - ma * ma, vb = sbb / n - mb * mb;
+      double cov = sab / n - ma * mb;
+      total += ((2 * ma * mb + c1) * (2 * cov + c2)) /
+               ((ma * ma + mb * mb + c1) * (va + vb + c2));
+      windows++;
+    }
+  }
+  return windows > 0 ? total / windows : 1.0;
+}
+
+// Grava a referência em PPM binário (P6), lido de volta por loadPPM
+bool saveReference(const std::string &filename, const Texture &image) {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Erro: Não foi possível criar a referência " << filename
+              << std::endl;
+    return false;
+  }
+  file << "P6\n" << image.width << " " << image.height << "\n255\n";
+  for (const Vec3 &c : image.data) {
+    unsigned char rgb[3] = {(unsigned char)lround(c.x * 255),
+                            (unsigned char)lround(c.y * 255),
+                            (unsigned char)lround(c.z * 255)};
+    file.write((const char *)rgb, 3);
+  }
+  return (bool)file;
+}
+
+// Campo de um registro do histórico (formato escrito por appendHistory)
+std::string historyField(const std::string &line, const std::string &key) {
+  std::string pattern = "\"" + key + "\":";
+  size_t pos = line.find(pattern);
+  if (pos == std::string::npos)
+    return "";
+  pos += pattern.size();
+  if (line[pos] == '"') {
+    size_t end = line.find('"', pos + 1);
+    return line.substr(pos + 1, end - pos - 1);
+  }
+  size_t end = line.find_first_of(",}", pos);
+  return line.substr(pos, end - pos);
+}
+
+// Aspas e barras invertidas escapadas para o JSON
+std::string jsonString(const std::string &text) {
+  std::string escaped = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\')
+      escaped += '\\';
+    escaped += c;
+  }
+  return escaped + "\"";
+}
+
+// Linha de base: mediana do tempo total nos últimos registros aceitos da
+// mesma cena, configuração e número de threads (0 se não houver)
+double baselineWall(const std::string &history, const PerfCase &perfCase,
+                    int threads) {
+  std::ifstream file(history);
+  std::vector<double> walls;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::string status = historyField(line, "status");
+    if (historyField(line, "scene") != perfCase.name ||
+        historyField(line, "config") != perfCase.config() ||
+        atoi(historyField(line, "threads").c_str()) != threads ||
+        (status != "ok" && status != "update"))
+      continue;
+    walls.push_back(atof(historyField(line, "wall_s").c_str()));
+  }
+  if (walls.empty())
+    return 0;
+  if ((int)walls.size() > PERF_BASELINE_RUNS)
+    walls.erase(walls.begin(), walls.end() - PERF_BASELINE_RUNS);
+  std::sort(walls.begin(), walls.end());
+  return walls[walls.size() / 2];
+}
+
+bool appendHistory(const std::string &history, const std::string &date,
+                   const PerfCase &perfCase, int threads,
+                   const PerfResult &result) {
+  std::ofstream file(history, std::ios::app);
+  if (!file.is_open()) {
+    std::cerr << "Erro: Não foi possível gravar o histórico " << history
+              << std::endl;
+    return false;
+  }
+  double raysPerSecond = result.render > 0 ? result.rays / result.render : 0;
+  file << std::fixed << std::setprecision(4) << "{\"date\":"
+       << jsonString(date) << ",\"scene\":" << jsonString(perfCase.name)
+       << ",\"config\":" << jsonString(perfCase.config())
+       << ",\"threads\":" << threads << ",\"wall_s\":" << result.wall
+       << ",\"render_s\":" << result.render << ",\"rays\":" << result.rays
+       << ",\"rays_per_s\":" << std::setprecision(0) << raysPerSecond
+       << ",\"peak_rss_kb\":" << result.peakRSS << std::setprecision(2)
+       << ",\"psnr\":" << result.psnr << std::setprecision(4)
+       << ",\"ssim\":" << result.ssim
+       << ",\"status\":" << jsonString(result.status) << "}\n";
+  return (bool)file;
+}
+
+// Renderiza uma cena settings.runs vezes e confere a imagem e o tempo
+PerfResult runCase(const PerfCase &perfCase, const PerfSettings &settings,
+                   int threads) {
+  PerfResult result;
+  std::string outputPath = settings.outputDir + "/" + perfCase.name + ".ppm";
+  std::vector<std::string> args = {perfCase.scene, outputPath};
+  args.insert(args.end(), perfCase.args.begin(), perfCase.args.end());
+
+  for (int run = 0; run < settings.runs; run++) {
+    std::string output;
+    double wall, render = 0, rays = 0;
+    long peakRSS;
+    if (!runRenderer(settings.executable, args, output, wall, peakRSS) ||
+        !findValue(output, "Tempo de renderização:", render) ||
+        !findValue(output, "Raios traçados:", rays)) {
+      result.status = "error";
+      return result;
+    }
+    if (run == 0 || wall < result.wall)
+      result.wall = wall;
+    if (run == 0 || render < result.render)
+      result.render = render;
+    result.rays = (uint64_t)rays;
+    result.peakRSS = std::max(result.peakRSS, peakRSS);
+  }
+
+  Texture image, reference;
+  std::string referencePath =
+      settings.referenceDir + "/" + perfCase.name + ".ppm";
+  if (!loadPPM(outputPath, image)) {
+    result.status = "error";
+    return result;
+  }
+  if (settings.update) {
+    result.psnr = PERF_PSNR_CAP;
+    result.ssim = 1.0;
+    result.status =
+        saveReference(referencePath, image) ? "update" : "error";
+    return result;
+  }
+
+  if (!std::ifstream(referencePath).good()) {
+    std::cerr << "Erro: Referência ausente " << referencePath
+              << " (gere com --update)" << std::endl;
+    result.status = "noref";
+    return result;
+  }
+  if (!loadPPM(referencePath, reference)) {
+    result.status = "noref";
+    return result;
+  }
+  if (reference.width != image.width || reference.height != image.height) {
+    std::cerr << "Erro: Referência de " << perfCase.name
+              << " com outra resolução" << std::endl;
+    result.status = "noref";
+    return result;
+  }
+  result.psnr = computePSNR(image, reference);
+  result.ssim = computeSSIM(image, reference);
+
+  result.baseline = baselineWall(settings.history, perfCase, threads);
+  result.status = "ok";
+  if (result.psnr < settings.minPSNR || result.ssim < settings.minSSIM)
+    result.status = "quality";
+  else if (result.baseline > 0 &&
+           result.wall > result.baseline * (1 + settings.tolerance) &&
+           result.wall - result.baseline > PERF_MIN_DELTA)
+    result.status = "slow";
+  return result;
+}
+
+bool parseNumber(const std::string &value, const std::string &name,
+                 double &out) {
+  char *end;
+  out = strtod(value.c_str(), &end);
+  if (*end || !(out >= 0)) {
+    std::cerr << "Erro: Valor inválido para " << name << ": " << value
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void printUsage(const char *name) {
+  std::cout << "Uso: " << name << " [opções] <lista.txt>\n"
+            << "Opções:\n"
+            << "  --exec ARQ      - Renderizador (padrão: ./a.out)\n"
+            << "  --refs DIR      - Imagens de referência (padrão: "
+               "tests/perf/ref)\n"
+            << "  --out DIR       - Imagens renderizadas (padrão: "
+               "obj/perf)\n"
+            << "  --history ARQ   - Histórico JSON, um registro por linha "
+               "(padrão: perf_history.jsonl)\n"
+            << "  --runs N        - Execuções por cena, vale a mais rápida "
+               "(padrão: 3)\n"
+            << "  --tolerance F   - Lentidão aceita sobre a linha de base "
+               "(padrão: 0.15)\n"
+            << "  --psnr DB       - PSNR mínimo (padrão: 38)\n"
+            << "  --ssim S        - SSIM mínimo (padrão: 0.98)\n"
+            << "  --update        - Regrava as referências\n";
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<char *> args(argv, argv + argc);
+  PerfSettings settings;
+  std::string value;
+  double number;
+
+  settings.update = takeFlag(args, "--update");
+  takeOption(args, "--exec", settings.executable);
+  takeOption(args, "--refs", settings.referenceDir);
+  takeOption(args, "--out", settings.outputDir);
+  takeOption(args, "--history", settings.history);
+  if (takeOption(args, "--runs", value)) {
+    if (!parseNumber(value, "--runs", number) || number < 1)
+      return 1;
+    settings.runs = (int)number;
+  }
+  if (takeOption(args, "--tolerance", value) &&
+      !parseNumber(value, "--tolerance", settings.tolerance))
+    return 1;
+  if (takeOption(args, "--psnr", value) &&
+      !parseNumber(value, "--psnr", settings.minPSNR))
+    return 1;
+  if (takeOption(args, "--ssim", value) &&
+      !parseNumber(value, "--ssim", settings.minSSIM))
+    return 1;
+  if (args.size() != 2) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  std::vector<PerfCase> cases;
+  if (!loadCases(args[1], cases))
+    return 1;
+
+  char date[32];
+  time_t now = time(nullptr);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+  int threads = omp_get_max_threads(); // O filho herda OMP_NUM_THREADS
+
+  std::cout << std::left << std::setw(14) << "cena" << std::right
+            << std::setw(9) << "tempo" << std::setw(9) << "base"
+            << std::setw(12) << "raios/s" << std::setw(9) << "RSS(MB)"
+            << std::setw(8) << "PSNR" << std::setw(8) << "SSIM"
+            << "  estado" << std::endl;
+
+  int failures = 0;
+  for (const PerfCase &perfCase : cases) {
+    PerfResult result = runCase(perfCase, settings, threads);
+    if (result.status != "ok" && result.status != "update")
+      failures++;
+    if (result.status != "error" &&
+        !appendHistory(settings.history, date, perfCase, threads, result))
+      return 1;
+
+    double raysPerSecond = result.render > 0 ? result.rays / result.render : 0;
+    std::cout << std::left << std::setw(14) << perfCase.name << std::right
+              << std::fixed << std::setprecision(3) << std::setw(9)
+              << result.wall << std::setw(9);
+    if (result.baseline > 0)
+      std::cout << result.baseline;
+    else
+      std::cout << "-";
+    std::cout << std::setw(12) << std::setprecision(0) << raysPerSecond
+              << std::setw(9) << std::setprecision(1)
+              << result.peakRSS / 1024.0 << std::setw(8)
+              << std::setprecision(2) << result.psnr << std::setw(8)
+              << std::setprecision(4) << result.ssim << "  "
+              << result.status << std::endl;
+  }
+
+  if (failures > 0) {
+    std::cerr << "Erro: " << failures << " cena(s) reprovada(s)" << std::endl;
+    return 1;
+  }
+  return 0;
+}
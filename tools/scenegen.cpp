@@ -0,0 +1,477 @@
+// Gerador de cenas procedurais (.in) para medir como o renderizador escala
+// com o número de objetos, de luzes e a profundidade dos CSGs. A mesma
+// semente gera sempre o mesmo arquivo.
+
+#include "options.h"
+#include "sampler.h"
+#include "vec3.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Distribuição espacial dos objetos
+enum Layout {
+  LAYOUT_UNIFORM,   // Uniforme no cubo da cena
+  LAYOUT_CLUSTERED, // Aglomerados gaussianos em torno de centros sorteados
+  LAYOUT_LAYERED    // Camadas horizontais empilhadas
+};
+
+// Tipos de objeto sorteados, na ordem dos pesos de --mix
+enum GenType { GEN_SPHERE, GEN_POLYHEDRON, GEN_QUADRIC, GEN_CSG, GEN_TYPES };
+
+// Acabamentos emitidos (sempre os mesmos, na ordem abaixo)
+enum GenFinish { FIN_MATTE, FIN_PLASTIC, FIN_MIRROR, FIN_GLASS, GEN_FINISHES };
+
+struct GenSettings {
+  int objects = 100;
+  double mix[GEN_TYPES] = {4, 2, 1, 1}; // Esferas, poliedros, quádricas, CSG
+  int csgDepth = 2;
+  int lights = 4;
+  int pigments = 8;
+  double checkerFraction = 0.25;
+  double texmapFraction = 0.25;
+  std::string texture = "blur.ppm";
+  double mirrorFraction = 0.1;
+  double glassFraction = 0.05;
+  Layout layout = LAYOUT_UNIFORM;
+  int clusters = 8;
+  int layers = 4;
+  double extent = 20.0; // Aresta do cubo centrado na origem
+  uint32_t seed = 0;
+};
+
+// Sequência pseudoaleatória determinística (mesmo hash do amostrador)
+struct GenRandom {
+  uint32_t seed;
+  uint32_t counter;
+
+  explicit GenRandom(uint32_t s) : seed(s), counter(0) {}
+
+  double next() { return toUnit(hashCombine(seed, counter++)); }
+  double range(double lo, double hi) { return lo + (hi - lo) * next(); }
+  int index(int count) { return std::min(count - 1, (int)(next() * count)); }
+
+  // Normal padrão (Box-Muller)
+  double gaussian() {
+    double u = std::max(next(), 1e-12);
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * next());
+  }
+
+  Vec3 direction() {
+    double z = range(-1.0, 1.0);
+    double phi = 2.0 * M_PI * next();
+    double r = sqrt(std::max(0.0, 1.0 - z * z));
+    return Vec3(r * cos(phi), r * sin(phi), z);
+  }
+
+  // Índice sorteado proporcionalmente aos pesos
+  int weighted(const double *weights, int count) {
+    double total = 0;
+    for (int i = 0; i < count; i++)
+      total += weights[i];
+    double u = next() * total;
+    for (int i = 0; i < count - 1; i++) {
+      if (u < weights[i])
+        return i;
+      u -= weights[i];
+    }
+    return count - 1;
+  }
+};
+
+std::string num(double value) {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(4) << value + 0.0; // Sem -0
+  return out.str();
+}
+
+std::string vec(const Vec3 &v) {
+  return num(v.x) + " " + num(v.y) + " " + num(v.z);
+}
+
+// Escreve a cena na ordem do formato: câmera, luzes, pigmentos, acabamentos
+// e objetos
+struct SceneGenerator {
+  const GenSettings &settings;
+  GenRandom rng;
+  double half, spacing;
+  std::vector<Vec3> centers; // Centros dos objetos do nível superior
+
+  explicit SceneGenerator(const GenSettings &s) : settings(s), rng(s.seed) {
+    half = settings.extent * 0.5;
+    // Raio típico: fração do espaçamento médio entre os objetos
+    spacing = settings.extent / cbrt(std::max(1, settings.objects));
+  }
+
+  void write(std::ostream &out) {
+    writeCamera(out);
+    writeLights(out);
+    writePigments(out);
+    writeFinishes(out);
+    placeCenters();
+
+    // O chão (semiespaço abaixo do cubo) vem depois dos objetos sorteados
+    out << settings.objects + 1 << "\n";
+    for (int i = 0; i < settings.objects; i++) {
+      GenType type = (GenType)rng.weighted(settings.mix, GEN_TYPES);
+      double radius = spacing * rng.range(0.15, 0.4);
+      writeObject(out, type, centers[i], radius, settings.csgDepth, "");
+    }
+    out << "0 " << FIN_MATTE << " polyhedron 1\n  0 1 0 " << num(half)
+        << "\n";
+  }
+
+  void writeCamera(std::ostream &out) {
+    out << vec(Vec3(0, 0.35, 1.6) * settings.extent) << "\n";
+    out << "0 0 0\n0 1 0\n45\n";
+  }
+
+  // Luz ambiente e luzes pontuais acima do cubo; a energia total não
+  // depende da quantidade
+  void writeLights(std::ostream &out) {
+    out << settings.lights + 1 << "\n";
+    out << "0 0 0  0.2 0.2 0.2  1 0 0\n";
+    double intensity = std::min(1.0, 1.5 / std::max(1, settings.lights));
+    for (int i = 0; i < settings.lights; i++) {
+      Vec3 pos(rng.range(-settings.extent, settings.extent),
+               rng.range(0.6, 1.2) * settings.extent,
+               rng.range(-settings.extent, settings.extent));
+      out << vec(pos) << "  " << vec(Vec3(1, 1, 1) * intensity)
+          << "  1 0 0\n";
+    }
+  }
+
+  Vec3 color() {
+    return Vec3(rng.range(0.2, 0.9), rng.range(0.2, 0.9), rng.range(0.2, 0.9));
+  }
+
+  // Pigmento 0 é o xadrez do chão; os demais são sorteados
+  void writePigments(std::ostream &out) {
+    out << settings.pigments + 1 << "\n";
+    out << "checker 0.9 0.9 0.9  0.2 0.2 0.2  " << num(spacing) << "\n";
+    for (int i = 0; i < settings.pigments; i++) {
+      double u = rng.next();
+      if (!settings.texture.empty() && u < settings.texmapFraction) {
+        // Projeção planar em x e y com escala da ordem de um objeto
+        double scale = 1.0 / (spacing * rng.range(0.5, 2.0));
+        out << "texmap " << settings.texture << "\n  " << num(scale)
+            << " 0 0 " << num(rng.next()) << "\n  0 " << num(scale) << " 0 "
+            << num(rng.next()) << "\n";
+      } else if (u < settings.texmapFraction + settings.checkerFraction) {
+        out << "checker " << vec(color()) << "  " << vec(color()) << "  "
+            << num(spacing * rng.range(0.05, 0.3)) << "\n";
+      } else {
+        out << "solid " << vec(color()) << "\n";
+      }
+    }
+  }
+
+  void writeFinishes(std::ostream &out) {
+    out << GEN_FINISHES << "\n";
+    out << "0.2 0.8 0.0 1 0 0 1\n";     // Fosco
+    out << "0.2 0.6 0.4 40 0 0 1\n";    // Plástico
+    out << "0.1 0.2 0.6 200 0.7 0 1\n"; // Espelho
+    out << "0.05 0.1 0.6 300 0.1 0.85 1.5\n"; // Vidro
+  }
+
+  // Vidro e espelho nas frações pedidas; o resto dividido entre fosco e
+  // plástico
+  int pickFinish() {
+    double u = rng.next();
+    double special = settings.glassFraction + settings.mirrorFraction;
+    if (u < settings.glassFraction)
+      return FIN_GLASS;
+    if (u < special)
+      return FIN_MIRROR;
+    return u < (1.0 + special) * 0.5 ? FIN_PLASTIC : FIN_MATTE;
+  }
+
+  Vec3 uniformPoint() {
+    return Vec3(rng.range(-half, half), rng.range(-half, half),
+                rng.range(-half, half));
+  }
+
+  void placeCenters() {
+    std::vector<Vec3> clusterCenters;
+    for (int i = 0; i < settings.clusters; i++)
+      clusterCenters.push_back(uniformPoint());
+    // Desvio dos aglomerados: juntos ocupam cerca de um quarto do cubo
+    double sigma = settings.extent /
+                   (4.0 * cbrt(std::max(1, settings.clusters)));
+
+    for (int i = 0; i < settings.objects; i++) {
+      Vec3 p = uniformPoint();
+      if (settings.layout == LAYOUT_CLUSTERED) {
+        p = clusterCenters[rng.index(settings.clusters)] +
+            Vec3(rng.gaussian(), rng.gaussian(), rng.gaussian()) * sigma;
+      } else if (settings.layout == LAYOUT_LAYERED) {
+        int layer = rng.index(settings.layers);
+        p.y = -half + settings.extent * (layer + 0.5) / settings.layers;
+      }
+      centers.push_back(p);
+    }
+  }
+
+  // Objeto completo (índices de pigmento e acabamento, tipo e parâmetros);
+  // indent prefixa as linhas dos filhos de CSG
+  void writeObject(std::ostream &out, GenType type, const Vec3 &c, double r,
+                   int depth, const std::string &indent) {
+    out << indent << 1 + rng.index(settings.pigments) << " " << pickFinish()
+        << " ";
+    if (type == GEN_CSG && depth > 0)
+      writeCSG(out, c, r, depth, indent);
+    else if (type == GEN_POLYHEDRON)
+      writePolyhedron(out, c, r, indent);
+    else if (type == GEN_QUADRIC)
+      writeQuadric(out, c, r);
+    else
+      out << "sphere " << vec(c) << " " << num(r) << "\n";
+  }
+
+  // Cubo com as arestas aparadas por planos sorteados (sempre limitado)
+  void writePolyhedron(std::ostream &out, const Vec3 &c, double r,
+                       const std::string &indent) {
+    std::vector<Vec3> normals = {Vec3(1, 0, 0), Vec3(-1, 0, 0), Vec3(0, 1, 0),
+                                 Vec3(0, -1, 0), Vec3(0, 0, 1),
+                                 Vec3(0, 0, -1)};
+    int cuts = 1 + rng.index(6);
+    for (int i = 0; i < cuts; i++)
+      normals.push_back(rng.direction());
+
+    out << "polyhedron " << normals.size() << "\n";
+    for (size_t i = 0; i < normals.size(); i++) {
+      // Face a uma distância h do centro: n.x - (n.c + h) <= 0 é o interior
+      double h = r * (i < 6 ? 0.8 : rng.range(0.7, 1.0));
+      const Vec3 &n = normals[i];
+      out << indent << "  " << vec(n) << " " << num(-(n.dot(c) + h)) << "\n";
+    }
+  }
+
+  // Elipsoide, cilindro ou cone (os dois últimos com caixa de recorte)
+  void writeQuadric(std::ostream &out, const Vec3 &c, double r) {
+    int kind = rng.index(3);
+    if (kind == 0) {
+      // (x - cx)^2 / a^2 + (y - cy)^2 / b^2 + (z - cz)^2 / c^2 = 1
+      Vec3 axes(r * rng.range(0.5, 1.0), r * rng.range(0.5, 1.0),
+                r * rng.range(0.5, 1.0));
+      Vec3 k(1 / (axes.x * axes.x), 1 / (axes.y * axes.y),
+             1 / (axes.z * axes.z));
+      double j = k.x * c.x * c.x + k.y * c.y * c.y + k.z * c.z * c.z - 1;
+      out << "quadric " << vec(k) << "  0 0 0  "
+          << vec(Vec3(-2 * k.x * c.x, -2 * k.y * c.y, -2 * k.z * c.z))
+          << "  " << num(j) << "\n";
+      return;
+    }
+
+    // Eixo vertical: (x - cx)^2 + (z - cz)^2 = s^2 (cilindro) ou
+    // s^2 (y - cy)^2 (cone)
+    double s = kind == 1 ? r * rng.range(0.4, 0.8) : rng.range(0.3, 0.8);
+    double ky = kind == 1 ? 0 : -s * s;
+    double j = c.x * c.x + c.z * c.z + ky * c.y * c.y;
+    if (kind == 1)
+      j -= s * s;
+    out << "quadric 1 " << num(ky) << " 1  0 0 0  "
+        << vec(Vec3(-2 * c.x, -2 * ky * c.y, -2 * c.z)) << "  " << num(j)
+        << " clip " << vec(c - Vec3(r, r, r)) << " " << vec(c + Vec3(r, r, r))
+        << "\n";
+  }
+
+  // União de um sólido com outro deslocado, menos um terceiro que morde a
+  // superfície; cada filho é outro CSG até a profundidade acabar
+  void writeCSG(std::ostream &out, const Vec3 &c, double r, int depth,
+                const std::string &indent) {
+    std::string inner = indent + "  ";
+    out << "csg 3\n";
+    out << inner << "+\n";
+    writeObject(out, closedType(), c, r * 0.8, depth - 1, inner);
+    out << inner << "+\n";
+    writeObject(out, closedType(), c + rng.direction() * (r * 0.5), r * 0.6,
+                depth - 1, inner);
+    out << inner << "-\n";
+    writeObject(out, closedType(), c + rng.direction() * (r * 0.7), r * 0.45,
+                depth - 1, inner);
+  }
+
+  // Filhos de CSG precisam ser sólidos fechados: quádricas ficam de fora
+  GenType closedType() {
+    double weights[GEN_TYPES] = {settings.mix[GEN_SPHERE],
+                                 settings.mix[GEN_POLYHEDRON], 0,
+                                 settings.mix[GEN_CSG]};
+    if (weights[0] + weights[1] <= 0)
+      weights[0] = 1;
+    return (GenType)rng.weighted(weights, GEN_TYPES);
+  }
+};
+
+bool parseCount(const std::string &value, const std::string &name, int &out,
+                int minimum) {
+  char *end;
+  long parsed = strtol(value.c_str(), &end, 10);
+  if (*end || parsed < minimum) {
+    std::cerr << "Erro: Valor inválido para " << name << ": " << value
+              << std::endl;
+    return false;
+  }
+  out = (int)parsed;
+  return true;
+}
+
+bool parseFraction(const std::string &value, const std::string &name,
+                   double &out) {
+  char *end;
+  out = strtod(value.c_str(), &end);
+  if (*end || !(out >= 0 && out <= 1)) {
+    std::cerr << "Erro: Fração inválida para " << name << ": " << value
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void printUsage(const char *name) {
+  std::cout << "Uso: " << name << " [opções] <saida.in>\n"
+            << "Opções:\n"
+            << "  --objects N     - Objetos sorteados, além do chão "
+               "(padrão: 100)\n"
+            << "  --mix E,P,Q,C   - Pesos de esferas, poliedros, quádricas e "
+               "CSG (padrão: 4,2,1,1)\n"
+            << "  --csg-depth N   - Níveis de CSG aninhados (padrão: 2)\n"
+            << "  --lights N      - Luzes pontuais, além da ambiente "
+               "(padrão: 4)\n"
+            << "  --pigments N    - Pigmentos sorteados (padrão: 8)\n"
+            << "  --checker F     - Fração de pigmentos xadrez (padrão: "
+               "0.25)\n"
+            << "  --texmap F      - Fração de pigmentos com textura "
+               "(padrão: 0.25)\n"
+            << "  --texture ARQ   - Textura PPM dos pigmentos texmap "
+               "(padrão: blur.ppm)\n"
+            << "  --mirror F      - Fração de objetos espelhados (padrão: "
+               "0.1)\n"
+            << "  --glass F       - Fração de objetos de vidro (padrão: "
+               "0.05)\n"
+            << "  --layout NOME   - uniform, clustered ou layered (padrão: "
+               "uniform)\n"
+            << "  --clusters N    - Aglomerados do layout clustered "
+               "(padrão: 8)\n"
+            << "  --layers N      - Camadas do layout layered (padrão: 4)\n"
+            << "  --extent X      - Aresta do cubo da cena (padrão: 20)\n"
+            << "  --seed N        - Semente (padrão: 0)\n";
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<char *> args(argv, argv + argc);
+  GenSettings settings;
+  std::string value;
+
+  if (takeOption(args, "--objects", value) &&
+      !parseCount(value, "--objects", settings.objects, 0))
+    return 1;
+  if (takeOption(args, "--csg-depth", value) &&
+      !parseCount(value, "--csg-depth", settings.csgDepth, 0))
+    return 1;
+  if (takeOption(args, "--lights", value) &&
+      !parseCount(value, "--lights", settings.lights, 0))
+    return 1;
+  if (takeOption(args, "--pigments", value) &&
+      !parseCount(value, "--pigments", settings.pigments, 1))
+    return 1;
+  if (takeOption(args, "--clusters", value) &&
+      !parseCount(value, "--clusters", settings.clusters, 1))
+    return 1;
+  if (takeOption(args, "--layers", value) &&
+      !parseCount(value, "--layers", settings.layers, 1))
+    return 1;
+  if (takeOption(args, "--checker", value) &&
+      !parseFraction(value, "--checker", settings.checkerFraction))
+    return 1;
+  if (takeOption(args, "--texmap", value) &&
+      !parseFraction(value, "--texmap", settings.texmapFraction))
+    return 1;
+  if (takeOption(args, "--mirror", value) &&
+      !parseFraction(value, "--mirror", settings.mirrorFraction))
+    return 1;
+  if (takeOption(args, "--glass", value) &&
+      !parseFraction(value, "--glass", settings.glassFraction))
+    return 1;
+  takeOption(args, "--texture", settings.texture);
+
+  if (takeOption(args, "--seed", value)) {
+    int seed;
+    if (!parseCount(value, "--seed", seed, 0))
+      return 1;
+    settings.seed = (uint32_t)seed;
+  }
+  if (takeOption(args, "--extent", value)) {
+    settings.extent = atof(value.c_str());
+    if (!(settings.extent > 0)) {
+      std::cerr << "Erro: Valor inválido para --extent: " << value
+                << std::endl;
+      return 1;
+    }
+  }
+  if (takeOption(args, "--layout", value)) {
+    if (value == "uniform")
+      settings.layout = LAYOUT_UNIFORM;
+    else if (value == "clustered")
+      settings.layout = LAYOUT_CLUSTERED;
+    else if (value == "layered")
+      settings.layout = LAYOUT_LAYERED;
+    else {
+      std::cerr << "Erro: Layout desconhecido " << value << std::endl;
+      return 1;
+    }
+  }
+  if (takeOption(args, "--mix", value)) {
+    std::istringstream fields(value);
+    double total = 0;
+    for (int i = 0; i < GEN_TYPES; i++) {
+      std::string field;
+      char *end;
+      if (!std::getline(fields, field, ',') ||
+          !((settings.mix[i] = strtod(field.c_str(), &end)) >= 0) || *end) {
+        std::cerr << "Erro: --mix espera 4 pesos não negativos: " << value
+                  << std::endl;
+        return 1;
+      }
+      total += settings.mix[i];
+    }
+    if (!(total > 0)) {
+      std::cerr << "Erro: --mix precisa de algum peso positivo" << std::endl;
+      return 1;
+    }
+  }
+  if (settings.checkerFraction + settings.texmapFraction > 1 ||
+      settings.mirrorFraction + settings.glassFraction > 1) {
+    std::cerr << "Erro: Frações somam mais que 1" << std::endl;
+    return 1;
+  }
+
+  if (args.size() != 2) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  std::ofstream out(args[1]);
+  if (!out.is_open()) {
+    std::cerr << "Erro: Não foi possível criar o arquivo " << args[1]
+              << std::endl;
+    return 1;
+  }
+  SceneGenerator generator(settings);
+  generator.write(out);
+  if (!out) {
+    std::cerr << "Erro: Falha ao escrever " << args[1] << std::endl;
+    return 1;
+  }
+
+  std::cout << "Cena gerada em " << args[1] << ": " << settings.objects
+            << " objetos, " << settings.lights << " luzes, semente "
+            << settings.seed << std::endl;
+  return 0;
+}